@@ -1,6 +1,9 @@
 #include <osgQOpenGL/CullVisitorEx>
 #include <osgQOpenGL/RenderStageEx>
 
+#include <osg/Geode>
+#include <osg/ValueObject>
+
 /// Needed for mixing osg rendering with Qt 2D drawing using QPainter...
 /// See http://forum.openscenegraph.org/viewtopic.php?t=15627&view=previous
 
@@ -101,6 +104,205 @@ public:
     RenderStageMap      _renderStageMap;
 };
 
+namespace
+{
+    bool sameCullSignature(const RenderStageEx::CullSignature& lhs,
+                           const RenderStageEx::CullSignature& rhs)
+    {
+        return lhs.projection == rhs.projection
+               && lhs.modelView == rhs.modelView
+               && lhs.viewport == rhs.viewport
+               && lhs.traversalMask == rhs.traversalMask
+               && lhs.lodScale == rhs.lodScale
+               && lhs.smallFeatureCullingPixelSize == rhs.smallFeatureCullingPixelSize
+               && lhs.sceneModifiedCount == rhs.sceneModifiedCount;
+    }
+
+    // the leaves kept from the previous frame are only alive if the stage was
+    // culled and drawn in the frame just before this one.
+    bool reusableStage(RenderStageEx* stage, const RenderStageEx::CullSignature& signature)
+    {
+        return stage
+               && stage->hasRecordedLeaves()
+               && stage->getCullSignature().valid
+               && stage->getCullSignature().frameNumber + 1 == signature.frameNumber
+               && sameCullSignature(stage->getCullSignature(), signature);
+    }
+}
+
+void CullVisitorEx::StageReuseCallback::operator()(osg::Node* node, osg::NodeVisitor* nv)
+{
+    CullVisitorEx* cv = dynamic_cast<CullVisitorEx*>(nv);
+    RenderStageEx* stage = cv ? dynamic_cast<RenderStageEx*>(cv->getRenderStage()) : 0;
+    osg::Camera* camera = node->asCamera();
+
+    if(!stage || !camera || !getCullResultReuse(*camera))
+    {
+        traverse(node, nv);
+        return;
+    }
+
+    // SceneView has reset the stage and pushed the camera's matrices and viewport
+    RenderStageEx::CullSignature signature = cv->cullSignature(cv->getViewport());
+    bool reuseStage = reusableStage(stage, signature);
+
+    stage->setRecordLeaves(true);
+
+    if(reuseStage)
+    {
+        stage->restoreLeaves();
+        ++cv->_numReusedStages;
+    }
+    else
+    {
+        traverse(node, nv);
+    }
+
+    stage->getCullSignature() = signature;
+}
+
+void CullVisitorEx::setCullResultReuse(osg::Camera& camera, bool flag)
+{
+    camera.setUserValue("CullResultReuse", flag);
+}
+
+bool CullVisitorEx::getCullResultReuse(const osg::Camera& camera)
+{
+    bool flag = false;
+    camera.getUserValue("CullResultReuse", flag);
+    return flag;
+}
+
+void CullVisitorEx::reset()
+{
+    osgUtil::CullVisitor::reset();
+
+    _numReusedStages = 0;
+    _occlusionBufferReady = false;
+}
+
+RenderStageEx::CullSignature CullVisitorEx::cullSignature(const osg::Viewport* viewport)
+{
+    RenderStageEx::CullSignature signature;
+    signature.projection = *getProjectionMatrix();
+    signature.modelView = *getModelViewMatrix();
+
+    // the near and far planes computed by the cull end up in the projection of the
+    // main camera, they do not change what is culled.
+    if(getComputeNearFarMode() != DO_NOT_COMPUTE_NEAR_FAR)
+    {
+        signature.projection(2, 2) = 0.0;
+        signature.projection(3, 2) = 0.0;
+    }
+
+    if(viewport)
+        signature.viewport.set(viewport->x(), viewport->y(), viewport->width(), viewport->height());
+
+    signature.traversalMask = getTraversalMask();
+    signature.lodScale = getLODScale();
+    signature.smallFeatureCullingPixelSize = getSmallFeatureCullingPixelSize();
+    signature.sceneModifiedCount = _sceneModifiedCount;
+    signature.frameNumber = getTraversalNumber();
+    signature.valid = true;
+
+    return signature;
+}
+
+bool CullVisitorEx::isOccluded(const osg::Node& node)
+{
+    // the frustum test is left to CullVisitor, the buffer does not test boxes that
+    // are off screen.
+    if(!node.isCullingActive())
+        return false;
+
+    const osg::BoundingSphere& bs = node.getBound();
+
+    if(!bs.valid())
+        return false;
+
+    osg::BoundingBox bb;
+    bb.expandBy(bs);
+    return isOccluded(bb);
+}
+
+bool CullVisitorEx::isOccluded(const osg::BoundingBox& bb)
+{
+    // the buffer is rasterized from the main view only, nested cameras have
+    // their own view and projection.
+    if(getCurrentRenderStage() != getRenderStage())
+        return false;
+
+    if(!_occlusionBufferReady)
+    {
+        _occlusionBufferReady = true;
+
+        // the first matrices pushed by SceneView are the view and projection of the main camera.
+        if(_modelviewStack.empty() || _projectionStack.empty())
+            return false;
+
+        _occlusionBuffer->rasterize(*_modelviewStack.front(), *_projectionStack.front());
+    }
+
+    return _occlusionBuffer->isOccluded(bb, (*getModelViewMatrix()) * (*getProjectionMatrix()));
+}
+
+void CullVisitorEx::apply(osg::Group& group)
+{
+    if(_occlusionBuffer.valid() && isOccluded(group))
+    {
+        _occlusionBuffer->recordCulledNode();
+        return;
+    }
+
+    osgUtil::CullVisitor::apply(group);
+}
+
+void CullVisitorEx::apply(osg::Transform& transform)
+{
+    if(_occlusionBuffer.valid() && isOccluded(transform))
+    {
+        _occlusionBuffer->recordCulledNode();
+        return;
+    }
+
+    osgUtil::CullVisitor::apply(transform);
+}
+
+void CullVisitorEx::apply(osg::Geode& geode)
+{
+    if(_occlusionBuffer.valid() && isOccluded(geode))
+    {
+        _occlusionBuffer->recordCulledNode();
+        return;
+    }
+
+    osgUtil::CullVisitor::apply(geode);
+}
+
+void CullVisitorEx::apply(osg::Drawable& drawable)
+{
+    if(_occlusionBuffer.valid() && drawable.isCullingActive())
+    {
+        const osg::BoundingBox& bb = drawable.getBoundingBox();
+
+        if(isOccluded(bb))
+        {
+            _occlusionBuffer->recordCulledDrawable();
+            return;
+        }
+    }
+
+    if(_idBufferPicker.valid() && getCurrentCamera() == _idBufferPicker->getCamera())
+    {
+        pushStateSet(_idBufferPicker->registerDrawable(getNodePath()));
+        osgUtil::CullVisitor::apply(drawable);
+        popStateSet();
+        return;
+    }
+
+    osgUtil::CullVisitor::apply(drawable);
+}
+
 void CullVisitorEx::apply(osg::Camera& camera)
 {
 
@@ -234,13 +436,26 @@ void CullVisitorEx::apply(osg::Camera& camera)
         }
 
         osg::ref_ptr<osgUtil::RenderStage> rtts = rsCache->getRenderStage(this);
+        RenderStageEx* rtsEx = static_cast<RenderStageEx*>(rtts.get());
+
+        // describe the inputs of this frame's cull so that it can be compared
+        // with the one that produced the cached stage.
+        RenderStageEx::CullSignature signature = cullSignature(camera.getViewport() != 0 ?
+                                                               camera.getViewport() :
+                                                               prevRenderStage->getViewport());
+
+        bool cullResultReuse = getCullResultReuse(camera);
+        bool reuseStage = cullResultReuse
+                          && !camera.getCullCallback()
+                          && reusableStage(rtsEx, signature);
 
         if(!rtts)
         {
             OpenThreads::ScopedLock<OpenThreads::Mutex> lock(*
                                                              (camera.getDataChangeMutex()));
 
-            rtts = new RenderStageEx();
+            rtsEx = new RenderStageEx();
+            rtts = rtsEx;
             rsCache->setRenderStage(this, rtts.get());
 
             rtts->setCamera(&camera);
@@ -267,12 +482,33 @@ void CullVisitorEx::apply(osg::Camera& camera)
                 rtts->setReadBuffer(camera.getReadBuffer());
             }
         }
+        else if(reuseStage)
+        {
+            // nothing that the cull depends on has changed, draw the previous frame's
+            // contents again.
+            rtsEx->restoreLeaves();
+            ++_numReusedStages;
+        }
         else
         {
             // reusing render to texture stage, so need to reset it to empty it from previous frames contents.
             rtts->reset();
         }
 
+        rtsEx->setRecordLeaves(cullResultReuse);
+
+        RenderStageEx* prevRenderStageEx = dynamic_cast<RenderStageEx*>(prevRenderStage);
+        rtsEx->setRadixSortCallback(prevRenderStageEx ? prevRenderStageEx->getRadixSortCallback() :
+                                    0);
+        rtsEx->setInstanceBatcher(prevRenderStageEx ? prevRenderStageEx->getInstanceBatcher() : 0);
+        rtsEx->setTextureResidencyManager(prevRenderStageEx ?
+                                          prevRenderStageEx->getTextureResidencyManager() : 0);
+        rtsEx->setMultisampleTarget(prevRenderStageEx ? prevRenderStageEx->getMultisampleTarget() : 0);
+
+        bool idBufferCamera = _idBufferPicker.valid() && &camera == _idBufferPicker->getCamera();
+        rtsEx->setDrawCallback(idBufferCamera ? _idBufferPicker.get() : 0);
+        rtsEx->getCullSignature() = signature;
+
         // **************************************************************
         // Code from RenderStage class
 
@@ -314,7 +550,12 @@ void CullVisitorEx::apply(osg::Camera& camera)
         setCurrentRenderBin(rtts.get());
 
         // traverse the subgraph
+        if(!reuseStage)
         {
+            // a reused stage keeps the ids of the table it was culled with
+            if(idBufferCamera)
+                _idBufferPicker->beginCull();
+
             handle_cull_callbacks_and_traverse(camera);
         }
 
@@ -0,0 +1,77 @@
+#include <osgQOpenGL/FrameBudgetGovernor>
+
+#include <algorithm>
+#include <numeric>
+
+FrameBudgetGovernor::FrameBudgetGovernor() :
+    _targetFrameTime(1.0 / 60.0),
+    _numLevels(8),
+    _windowSize(30),
+    _degradeTolerance(0.1),
+    _improveTolerance(0.25),
+    _level(0),
+    _averageFrameTime(0.0)
+{
+    _lodScaleRange[0] = 1.0f;
+    _lodScaleRange[1] = 4.0f;
+    _pixelSizeRange[0] = 1.0f;
+    _pixelSizeRange[1] = 16.0f;
+}
+
+void FrameBudgetGovernor::setTargetFrameRate(double frameRate)
+{
+    _targetFrameTime = 1.0 / std::max(frameRate, 1.0);
+    _frameTimes.clear();
+}
+
+void FrameBudgetGovernor::setNumLevels(unsigned int levels)
+{
+    _numLevels = std::max(levels, 1u);
+    _level = std::min(_level, _numLevels);
+}
+
+void FrameBudgetGovernor::setWindowSize(unsigned int frames)
+{
+    _windowSize = std::max(frames, 1u);
+    _frameTimes.clear();
+}
+
+bool FrameBudgetGovernor::addFrameTime(double seconds)
+{
+    _frameTimes.push_back(seconds);
+
+    if(_frameTimes.size() < _windowSize)
+        return false;
+
+    _averageFrameTime = std::accumulate(_frameTimes.begin(), _frameTimes.end(), 0.0) /
+                        _frameTimes.size();
+    _frameTimes.clear();
+
+    unsigned int level = _level;
+
+    if(_averageFrameTime > _targetFrameTime * (1.0 + _degradeTolerance) && _level < _numLevels)
+        ++_level;
+    else if(_averageFrameTime < _targetFrameTime * (1.0 - _improveTolerance) && _level > 0)
+        --_level;
+
+    return level != _level;
+}
+
+void FrameBudgetGovernor::reset()
+{
+    _level = 0;
+    _averageFrameTime = 0.0;
+    _frameTimes.clear();
+}
+
+float FrameBudgetGovernor::getLODScale() const
+{
+    float t = static_cast<float>(_level) / _numLevels;
+    return _lodScaleRange[0] + (_lodScaleRange[1] - _lodScaleRange[0]) * t;
+}
+
+float FrameBudgetGovernor::getSmallFeatureCullingPixelSize() const
+{
+    float t = static_cast<float>(_level) / _numLevels;
+    return _pixelSizeRange[0] + (_pixelSizeRange[1] - _pixelSizeRange[0]) * t;
+}
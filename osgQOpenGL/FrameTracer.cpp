@@ -0,0 +1,160 @@
+#include <osgQOpenGL/FrameTracer>
+
+#include <OpenThreads/ScopedLock>
+
+#include <fstream>
+
+std::atomic<bool> FrameTracer::s_enabled(false);
+
+namespace
+{
+    // JSON string escaping of zone and thread names
+    std::string escape(const std::string& text)
+    {
+        std::string result;
+
+        for(std::string::const_iterator itr = text.begin(); itr != text.end(); ++itr)
+        {
+            if(*itr == '"' || *itr == '\\')
+                result += '\\';
+
+            if(static_cast<unsigned char>(*itr) >= 0x20)
+                result += *itr;
+        }
+
+        return result;
+    }
+}
+
+FrameTracer* FrameTracer::instance()
+{
+    static FrameTracer s_tracer;
+    return &s_tracer;
+}
+
+FrameTracer::FrameTracer() :
+    _bufferSize(1 << 16),
+    _startTick(osg::Timer::instance()->tick())
+{
+}
+
+FrameTracer::~FrameTracer()
+{
+    s_enabled = false;
+
+    for(std::vector<ThreadBuffer*>::iterator itr = _buffers.begin(); itr != _buffers.end(); ++itr)
+    {
+        delete *itr;
+    }
+}
+
+void FrameTracer::start()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    // zones being recorded at this moment may end up on either side of the start
+    for(std::vector<ThreadBuffer*>::iterator itr = _buffers.begin(); itr != _buffers.end(); ++itr)
+    {
+        (*itr)->startCount = (*itr)->count.load(std::memory_order_acquire);
+    }
+
+    _startTick = osg::Timer::instance()->tick();
+    s_enabled = true;
+}
+
+void FrameTracer::stop()
+{
+    s_enabled = false;
+}
+
+FrameTracer::ThreadBuffer* FrameTracer::getThreadBuffer()
+{
+    // buffers outlive their threads so that their zones can still be written
+    static thread_local ThreadBuffer* s_buffer = 0;
+
+    if(!s_buffer)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+        s_buffer = new ThreadBuffer;
+        s_buffer->id = static_cast<unsigned int>(_buffers.size()) + 1;
+        s_buffer->events.resize(_bufferSize);
+        s_buffer->count = 0;
+        s_buffer->startCount = 0;
+        _buffers.push_back(s_buffer);
+    }
+
+    return s_buffer;
+}
+
+void FrameTracer::record(const char* name, osg::Timer_t begin, osg::Timer_t end)
+{
+    ThreadBuffer* buffer = getThreadBuffer();
+    unsigned long long count = buffer->count.load(std::memory_order_relaxed);
+
+    Event& event = buffer->events[count % buffer->events.size()];
+    event.name = name;
+    event.begin = begin;
+    event.end = end;
+
+    buffer->count.store(count + 1, std::memory_order_release);
+}
+
+void FrameTracer::setThreadName(const std::string& name)
+{
+    ThreadBuffer* buffer = getThreadBuffer();
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+    buffer->name = name;
+}
+
+bool FrameTracer::write(const std::string& fileName) const
+{
+    std::ofstream output(fileName.c_str());
+
+    if(!output)
+        return false;
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+    const osg::Timer* timer = osg::Timer::instance();
+    bool first = true;
+
+    output << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    for(std::vector<ThreadBuffer*>::const_iterator itr = _buffers.begin(); itr != _buffers.end(); ++itr)
+    {
+        const ThreadBuffer* buffer = *itr;
+        unsigned long long count = buffer->count.load(std::memory_order_acquire);
+        unsigned long long size = buffer->events.size();
+        unsigned long long begin = buffer->startCount;
+
+        if(count - begin > size)
+            begin = count - size;
+
+        if(!buffer->name.empty())
+        {
+            output << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+                   << buffer->id << ",\"args\":{\"name\":\"" << escape(buffer->name) << "\"}}";
+            first = false;
+        }
+
+        for(unsigned long long i = begin; i < count; ++i)
+        {
+            const Event& event = buffer->events[i % size];
+
+            // zones begun before the start
+            if(event.begin < _startTick)
+                continue;
+
+            output << (first ? "" : ",") << "\n{\"name\":\"" << escape(event.name)
+                   << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id
+                   << ",\"ts\":" << timer->delta_u(_startTick, event.begin)
+                   << ",\"dur\":" << timer->delta_u(event.begin, event.end) << "}";
+            first = false;
+        }
+    }
+
+    output << "\n]}" << std::endl;
+
+    return static_cast<bool>(output);
+}
@@ -0,0 +1,184 @@
+#include <osgQOpenGL/FxaaPass>
+#include <osgQOpenGL/FrameTracer>
+
+#include <osg/GLExtensions>
+#include <osg/GraphicsContext>
+#include <osg/Program>
+
+#include <algorithm>
+
+#ifndef GL_DEPTH24_STENCIL8_EXT
+#define GL_DEPTH24_STENCIL8_EXT 0x88F0
+#endif
+
+namespace
+{
+    // a triangle covering the viewport, positions in clip space
+    const char* FXAA_VERTEX_SHADER =
+        "#version 130\n"
+        "void main()\n"
+        "{\n"
+        "    gl_Position = vec4(gl_Vertex.xy, 0.0, 1.0);\n"
+        "}\n";
+
+    // FXAA after Timothy Lottes' PC console version: blend along the edge direction
+    // estimated from the luma of the diagonal neighbours
+    const char* FXAA_FRAGMENT_SHADER =
+        "#version 130\n"
+        "uniform sampler2D fxaaInput;\n"
+        "uniform vec2 fxaaInverseSize;\n"
+        "uniform float fxaaSpanMax;\n"
+        "out vec4 fragColor;\n"
+        "const vec3 LUMA = vec3(0.299, 0.587, 0.114);\n"
+        "const float REDUCE_MIN = 1.0 / 128.0;\n"
+        "const float REDUCE_MUL = 1.0 / 8.0;\n"
+        "vec3 fetch(vec2 uv)\n"
+        "{\n"
+        "    return texture(fxaaInput, uv).rgb;\n"
+        "}\n"
+        "void main()\n"
+        "{\n"
+        "    vec2 uv = gl_FragCoord.xy * fxaaInverseSize;\n"
+        "    vec4 center = texture(fxaaInput, uv);\n"
+        "    float lumaNW = dot(fetch(uv + vec2(-1.0, -1.0) * fxaaInverseSize), LUMA);\n"
+        "    float lumaNE = dot(fetch(uv + vec2(1.0, -1.0) * fxaaInverseSize), LUMA);\n"
+        "    float lumaSW = dot(fetch(uv + vec2(-1.0, 1.0) * fxaaInverseSize), LUMA);\n"
+        "    float lumaSE = dot(fetch(uv + vec2(1.0, 1.0) * fxaaInverseSize), LUMA);\n"
+        "    float lumaM = dot(center.rgb, LUMA);\n"
+        "    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));\n"
+        "    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));\n"
+        "    vec2 dir = vec2(-((lumaNW + lumaNE) - (lumaSW + lumaSE)),\n"
+        "                    (lumaNW + lumaSW) - (lumaNE + lumaSE));\n"
+        "    float dirReduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * 0.25 * REDUCE_MUL, REDUCE_MIN);\n"
+        "    float rcpDirMin = 1.0 / (min(abs(dir.x), abs(dir.y)) + dirReduce);\n"
+        "    dir = clamp(dir * rcpDirMin, vec2(-fxaaSpanMax), vec2(fxaaSpanMax)) * fxaaInverseSize;\n"
+        "    vec3 rgbA = 0.5 * (fetch(uv + dir * (1.0 / 3.0 - 0.5)) + fetch(uv + dir * (2.0 / 3.0 - 0.5)));\n"
+        "    vec3 rgbB = rgbA * 0.5 + 0.25 * (fetch(uv - dir * 0.5) + fetch(uv + dir * 0.5));\n"
+        "    float lumaB = dot(rgbB, LUMA);\n"
+        "    fragColor = vec4(lumaB < lumaMin || lumaB > lumaMax ? rgbA : rgbB, center.a);\n"
+        "}\n";
+}
+
+FxaaPass::FxaaPass() :
+    _width(0),
+    _height(0),
+    _gpuTimer(new GpuTimer)
+{
+    _colorTexture = new osg::Texture2D();
+    _colorTexture->setTextureSize(1, 1);
+    _colorTexture->setInternalFormat(GL_RGBA8);
+    _colorTexture->setSourceFormat(GL_RGBA);
+    _colorTexture->setSourceType(GL_UNSIGNED_BYTE);
+    _colorTexture->setResizeNonPowerOfTwoHint(false);
+    // the filter samples between pixels
+    _colorTexture->setFilter(osg::Texture::MIN_FILTER, osg::Texture::LINEAR);
+    _colorTexture->setFilter(osg::Texture::MAG_FILTER, osg::Texture::LINEAR);
+    _colorTexture->setWrap(osg::Texture::WRAP_S, osg::Texture::CLAMP_TO_EDGE);
+    _colorTexture->setWrap(osg::Texture::WRAP_T, osg::Texture::CLAMP_TO_EDGE);
+
+    _fbo = new osg::FrameBufferObject();
+    resize(1, 1);
+
+    osg::Vec3Array* vertices = new osg::Vec3Array();
+    vertices->push_back(osg::Vec3(-1.0f, -1.0f, 0.0f));
+    vertices->push_back(osg::Vec3(3.0f, -1.0f, 0.0f));
+    vertices->push_back(osg::Vec3(-1.0f, 3.0f, 0.0f));
+
+    _geometry = new osg::Geometry();
+    _geometry->setName("FxaaPass");
+    _geometry->setUseDisplayList(false);
+    _geometry->setUseVertexBufferObjects(true);
+    _geometry->setVertexArray(vertices);
+    _geometry->addPrimitiveSet(new osg::DrawArrays(GL_TRIANGLES, 0, 3));
+
+    osg::Program* program = new osg::Program();
+    program->setName("FxaaPass");
+    program->addShader(new osg::Shader(osg::Shader::VERTEX, FXAA_VERTEX_SHADER));
+    program->addShader(new osg::Shader(osg::Shader::FRAGMENT, FXAA_FRAGMENT_SHADER));
+
+    _inverseSize = new osg::Uniform("fxaaInverseSize", osg::Vec2(1.0f, 1.0f));
+    _spanMax = new osg::Uniform("fxaaSpanMax", 8.0f);
+
+    // the state left by the last leaf of the stage must not reach the filter
+    const unsigned int on = osg::StateAttribute::ON | osg::StateAttribute::OVERRIDE |
+                            osg::StateAttribute::PROTECTED;
+    const unsigned int off = osg::StateAttribute::OFF | osg::StateAttribute::OVERRIDE |
+                             osg::StateAttribute::PROTECTED;
+    _stateSet = new osg::StateSet();
+    _stateSet->setAttributeAndModes(program, on);
+    _stateSet->setTextureAttributeAndModes(0, _colorTexture.get(), on);
+    _stateSet->addUniform(new osg::Uniform("fxaaInput", 0));
+    _stateSet->addUniform(_inverseSize.get());
+    _stateSet->addUniform(_spanMax.get());
+    _stateSet->setMode(GL_DEPTH_TEST, off);
+    _stateSet->setMode(GL_BLEND, off);
+    _stateSet->setMode(GL_CULL_FACE, off);
+    _stateSet->setMode(GL_STENCIL_TEST, off);
+}
+
+FxaaPass::~FxaaPass()
+{
+}
+
+void FxaaPass::resize(int width, int height)
+{
+    width = std::max(width, 1);
+    height = std::max(height, 1);
+
+    if(width == _width && height == _height)
+        return;
+
+    _width = width;
+    _height = height;
+
+    _colorTexture->setTextureSize(width, height);
+    _colorTexture->dirtyTextureObject();
+
+    // setting the attachments again makes the object rebuild them
+    _fbo->setAttachment(osg::Camera::COLOR_BUFFER0, osg::FrameBufferAttachment(_colorTexture.get()));
+    _fbo->setAttachment(osg::Camera::PACKED_DEPTH_STENCIL_BUFFER,
+                        osg::FrameBufferAttachment(new osg::RenderBuffer(width, height,
+                                                                         GL_DEPTH24_STENCIL8_EXT)));
+
+    if(_inverseSize.valid())
+        _inverseSize->set(osg::Vec2(1.0f / width, 1.0f / height));
+}
+
+void FxaaPass::setSpanMax(float pixels)
+{
+    _spanMax->set(pixels);
+}
+
+float FxaaPass::getSpanMax() const
+{
+    float pixels = 0.0f;
+    _spanMax->get(pixels);
+    return pixels;
+}
+
+void FxaaPass::operator()(osg::RenderInfo& renderInfo, RenderStageEx& stage)
+{
+    if(stage.getFrameBufferObject() != _fbo.get())
+        return;
+
+    OSGQOPENGL_TRACE_ZONE("FXAA");
+    osg::State& state = *renderInfo.getState();
+    const osg::GLExtensions* ext = state.get<osg::GLExtensions>();
+
+    if(!ext->isFrameBufferObjectSupported)
+        return;
+
+    // the stage is drawn into our framebuffer object, filter it into the window's
+    GLuint defaultFbo = state.getGraphicsContext() ? state.getGraphicsContext()->getDefaultFboId() : 0;
+    ext->glBindFramebuffer(GL_FRAMEBUFFER_EXT, defaultFbo);
+
+    _gpuTimer->begin();
+
+    state.pushStateSet(_stateSet.get());
+    state.apply();
+    _geometry->draw(renderInfo);
+    state.popStateSet();
+    state.apply();
+
+    _gpuTimer->end();
+}
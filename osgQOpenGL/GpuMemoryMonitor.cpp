@@ -0,0 +1,378 @@
+#include <osgQOpenGL/GpuMemoryMonitor>
+
+#include <osg/BufferObject>
+#include <osg/Camera>
+#include <osg/FrameBufferObject>
+#include <osg/GLExtensions>
+#include <osg/Geometry>
+#include <osg/NodeVisitor>
+#include <osg/Program>
+#include <osg/Texture>
+
+#include <algorithm>
+#include <set>
+
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+
+namespace
+{
+    // storage bytes per pixel of a render buffer format, drivers pad 24 bit formats
+    unsigned int bytesPerPixel(GLenum internalFormat, osg::Camera::BufferComponent component)
+    {
+        switch(internalFormat)
+        {
+        case GL_RGBA16F_ARB:
+        case GL_RGB16F_ARB:
+            return 8;
+
+        case GL_RGBA32F_ARB:
+        case GL_RGB32F_ARB:
+            return 16;
+
+        case GL_STENCIL_INDEX8_EXT:
+            return 1;
+
+        case 0:
+            return component == osg::Camera::STENCIL_BUFFER ? 1 : 4;
+
+        default:
+            return 4;
+        }
+    }
+
+    std::string objectName(const osg::Object& object)
+    {
+        return object.getName().empty() ? std::string(object.className()) : object.getName();
+    }
+
+    bool largerAllocation(const GpuMemoryMonitor::Allocation& lhs, const GpuMemoryMonitor::Allocation& rhs)
+    {
+        return lhs.bytes > rhs.bytes;
+    }
+}
+
+class GpuMemoryMonitor::CollectVisitor : public osg::NodeVisitor
+{
+public:
+    CollectVisitor(osg::State& state, AllocationList& allocations) :
+        osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
+        _state(state),
+        _contextID(state.getContextID()),
+        _allocations(allocations)
+    {
+        setNodeMaskOverride(~0u);
+        _programBinaryLength = osg::isGLExtensionOrVersionSupported(_contextID,
+                                                                    "GL_ARB_get_program_binary", 4.1f);
+    }
+
+    void apply(osg::Node& node) override
+    {
+        applyStateSet(node.getStateSet());
+        traverse(node);
+    }
+
+    void apply(osg::Camera& camera) override
+    {
+        if(camera.getRenderTargetImplementation() == osg::Camera::FRAME_BUFFER_OBJECT
+           && camera.getViewport())
+        {
+            // attachments without texture or image are render buffers of the viewport size
+            const osg::Camera::BufferAttachmentMap& attachments = camera.getBufferAttachmentMap();
+
+            for(osg::Camera::BufferAttachmentMap::const_iterator itr = attachments.begin();
+                itr != attachments.end();
+                ++itr)
+            {
+                if(itr->second._texture.valid() || itr->second._image.valid())
+                    continue;
+
+                unsigned long long bytes = static_cast<unsigned long long>(camera.getViewport()->width())
+                                           * static_cast<unsigned long long>(camera.getViewport()->height())
+                                           * bytesPerPixel(itr->second._internalFormat, itr->first)
+                                           * std::max(itr->second._multisampleSamples, 1u);
+
+                add(RENDERBUFFER, &camera, objectName(camera) + " attachment", bytes);
+            }
+        }
+
+        apply(static_cast<osg::Node&>(camera));
+    }
+
+    void apply(osg::Drawable& drawable) override
+    {
+        applyStateSet(drawable.getStateSet());
+
+        osg::Geometry* geometry = drawable.asGeometry();
+
+        if(!geometry)
+            return;
+
+        osg::Geometry::ArrayList arrays;
+        geometry->getArrayList(arrays);
+
+        for(osg::Geometry::ArrayList::iterator itr = arrays.begin(); itr != arrays.end(); ++itr)
+        {
+            applyBufferObject((*itr)->getBufferObject());
+        }
+
+        osg::Geometry::DrawElementsList drawElements;
+        geometry->getDrawElementsList(drawElements);
+
+        for(osg::Geometry::DrawElementsList::iterator itr = drawElements.begin(); itr != drawElements.end(); ++itr)
+        {
+            applyBufferObject((*itr)->getBufferObject());
+        }
+    }
+
+protected:
+    void applyStateSet(osg::StateSet* stateSet)
+    {
+        if(!stateSet || !_visited.insert(stateSet).second)
+            return;
+
+        const osg::StateSet::TextureAttributeList& textureAttributes = stateSet->getTextureAttributeList();
+
+        for(unsigned int unit = 0; unit < textureAttributes.size(); ++unit)
+        {
+            for(osg::StateSet::AttributeList::const_iterator itr = textureAttributes[unit].begin();
+                itr != textureAttributes[unit].end();
+                ++itr)
+            {
+                if(itr->second.first.valid())
+                    applyTexture(itr->second.first->asTexture());
+            }
+        }
+
+        applyProgram(dynamic_cast<osg::Program*>(stateSet->getAttribute(osg::StateAttribute::PROGRAM)));
+        applyFrameBufferObject(dynamic_cast<osg::FrameBufferObject*>(
+                                   stateSet->getAttribute(osg::StateAttribute::FRAME_BUFFER_OBJECT)));
+    }
+
+    void applyTexture(osg::Texture* texture)
+    {
+        if(!texture || !_visited.insert(texture).second)
+            return;
+
+        osg::Texture::TextureObject* textureObject = texture->getTextureObject(_contextID);
+
+        if(textureObject)
+            add(TEXTURE, texture, objectName(*texture), textureObject->size());
+    }
+
+    void applyBufferObject(osg::BufferObject* bufferObject)
+    {
+        if(!bufferObject || !_visited.insert(bufferObject).second)
+            return;
+
+        osg::GLBufferObject* glBufferObject = bufferObject->getGLBufferObject(_contextID);
+
+        if(glBufferObject)
+            add(BUFFER, bufferObject, objectName(*bufferObject), glBufferObject->getProfile()._size);
+    }
+
+    void applyProgram(osg::Program* program)
+    {
+        if(!program || !_visited.insert(program).second)
+            return;
+
+        // the programs of the drawn scene already have their per context program
+        osg::Program::PerContextProgram* pcp = program->getPCP(_state);
+        GLint length = 0;
+
+        if(!pcp || !pcp->isLinked())
+            return;
+
+        if(_programBinaryLength)
+            _state.get<osg::GLExtensions>()->glGetProgramiv(pcp->getHandle(), GL_PROGRAM_BINARY_LENGTH, &length);
+
+        add(PROGRAM, program, objectName(*program), static_cast<unsigned long long>(std::max(length, 0)));
+    }
+
+    void applyFrameBufferObject(osg::FrameBufferObject* fbo)
+    {
+        if(!fbo)
+            return;
+
+        const osg::FrameBufferObject::AttachmentMap& attachments = fbo->getAttachmentMap();
+
+        for(osg::FrameBufferObject::AttachmentMap::const_iterator itr = attachments.begin();
+            itr != attachments.end();
+            ++itr)
+        {
+            const osg::RenderBuffer* renderBuffer = itr->second.getRenderBuffer();
+
+            if(!renderBuffer || !_visited.insert(renderBuffer).second)
+                continue;
+
+            unsigned long long bytes = static_cast<unsigned long long>(renderBuffer->getWidth())
+                                       * static_cast<unsigned long long>(renderBuffer->getHeight())
+                                       * bytesPerPixel(renderBuffer->getInternalFormat(), osg::Camera::COLOR_BUFFER)
+                                       * std::max(renderBuffer->getSamples(), 1);
+
+            add(RENDERBUFFER, renderBuffer, objectName(*renderBuffer), bytes);
+        }
+    }
+
+    void add(ObjectType type, const osg::Object* object, const std::string& name, unsigned long long bytes)
+    {
+        Allocation allocation;
+        allocation.type = type;
+        allocation.name = name;
+        allocation.bytes = bytes;
+        allocation.object = object;
+        _allocations.push_back(allocation);
+    }
+
+    osg::State&                     _state;
+    unsigned int                    _contextID;
+    AllocationList&                 _allocations;
+    bool                            _programBinaryLength;
+    std::set<const osg::Object*>    _visited;
+};
+
+GpuMemoryMonitor::GpuMemoryMonitor() :
+    _updateInterval(60),
+    _budget(0)
+{
+}
+
+const char* GpuMemoryMonitor::getTypeName(ObjectType type)
+{
+    switch(type)
+    {
+    case TEXTURE:
+        return "texture";
+
+    case BUFFER:
+        return "buffer";
+
+    case RENDERBUFFER:
+        return "renderbuffer";
+
+    case PROGRAM:
+        return "program";
+
+    default:
+        return "";
+    }
+}
+
+void GpuMemoryMonitor::setExternalAllocation(unsigned int contextID, const std::string& name,
+                                             ObjectType type, unsigned long long bytes)
+{
+    std::map<std::string, Allocation>& external = _contexts[contextID].externalAllocations;
+
+    if(bytes == 0)
+    {
+        external.erase(name);
+        return;
+    }
+
+    Allocation& allocation = external[name];
+    allocation.type = type;
+    allocation.name = name;
+    allocation.bytes = bytes;
+}
+
+void GpuMemoryMonitor::update(osg::State& state, osg::Node* scene)
+{
+    ContextData& data = _contexts[state.getContextID()];
+
+    if(data.framesToUpdate > 0)
+    {
+        --data.framesToUpdate;
+        return;
+    }
+
+    measure(state, scene);
+}
+
+void GpuMemoryMonitor::measure(osg::State& state, osg::Node* scene)
+{
+    unsigned int contextID = state.getContextID();
+    ContextData& data = _contexts[contextID];
+    data.framesToUpdate = _updateInterval - 1;
+    data.allocations.clear();
+
+    if(scene)
+    {
+        CollectVisitor visitor(state, data.allocations);
+        scene->accept(visitor);
+    }
+
+    for(std::map<std::string, Allocation>::const_iterator itr = data.externalAllocations.begin();
+        itr != data.externalAllocations.end();
+        ++itr)
+    {
+        data.allocations.push_back(itr->second);
+    }
+
+    Usage usage;
+
+    for(AllocationList::const_iterator itr = data.allocations.begin(); itr != data.allocations.end(); ++itr)
+    {
+        usage.bytes[itr->type] += itr->bytes;
+        ++usage.numObjects[itr->type];
+    }
+
+    // the pools also hold the objects of other scenes and the orphaned ones
+    unsigned long long texturePool = osg::get<osg::TextureObjectManager>(contextID)->getCurrTexturePoolSize();
+    unsigned long long bufferPool = osg::get<osg::GLBufferObjectManager>(contextID)->getCurrGLBufferObjectPoolSize();
+
+    if(texturePool > usage.bytes[TEXTURE])
+    {
+        usage.unreferencedTextureBytes = texturePool - usage.bytes[TEXTURE];
+        usage.bytes[TEXTURE] = texturePool;
+    }
+
+    if(bufferPool > usage.bytes[BUFFER])
+    {
+        usage.unreferencedBufferBytes = bufferPool - usage.bytes[BUFFER];
+        usage.bytes[BUFFER] = bufferPool;
+    }
+
+    data.usage = usage;
+
+    bool overBudget = _budget > 0 && usage.getTotal() > _budget;
+
+    if(overBudget && !data.overBudget && _budgetCallback.valid())
+        (*_budgetCallback)(contextID, usage);
+
+    data.overBudget = overBudget;
+}
+
+std::vector<unsigned int> GpuMemoryMonitor::getContextIDs() const
+{
+    std::vector<unsigned int> contextIDs;
+
+    for(ContextDataMap::const_iterator itr = _contexts.begin(); itr != _contexts.end(); ++itr)
+    {
+        contextIDs.push_back(itr->first);
+    }
+
+    return contextIDs;
+}
+
+GpuMemoryMonitor::Usage GpuMemoryMonitor::getUsage(unsigned int contextID) const
+{
+    ContextDataMap::const_iterator itr = _contexts.find(contextID);
+    return itr != _contexts.end() ? itr->second.usage : Usage();
+}
+
+GpuMemoryMonitor::AllocationList GpuMemoryMonitor::getLargestAllocations(unsigned int contextID,
+                                                                         unsigned int count) const
+{
+    ContextDataMap::const_iterator itr = _contexts.find(contextID);
+
+    if(itr == _contexts.end())
+        return AllocationList();
+
+    AllocationList allocations = itr->second.allocations;
+    count = std::min(count, static_cast<unsigned int>(allocations.size()));
+    std::partial_sort(allocations.begin(), allocations.begin() + count, allocations.end(), largerAllocation);
+    allocations.resize(count);
+
+    return allocations;
+}
@@ -0,0 +1,115 @@
+#include <osgQOpenGL/GpuTimer>
+
+#if !defined(QT_OPENGL_ES_2)
+#include <QOpenGLTimerQuery>
+#endif
+
+namespace
+{
+    // sections in flight, the results are usually available two frames later
+    const unsigned int NUM_SECTIONS = 4;
+}
+
+GpuTimer::GpuTimer() :
+    _sections(NUM_SECTIONS),
+    _next(0),
+    _oldest(0),
+    _supported(true),
+    _started(false),
+    _averageTime(0.0)
+{
+}
+
+GpuTimer::~GpuTimer()
+{
+}
+
+bool GpuTimer::create(Section& section)
+{
+#if !defined(QT_OPENGL_ES_2)
+
+    if(section.start)
+        return true;
+
+    section.start.reset(new QOpenGLTimerQuery());
+    section.end.reset(new QOpenGLTimerQuery());
+
+    if(section.start->create() && section.end->create())
+        return true;
+
+    section.start.reset();
+    section.end.reset();
+#endif
+    return false;
+}
+
+void GpuTimer::begin(int tag)
+{
+    if(!_supported || _started)
+        return;
+
+    Section& section = _sections[_next];
+
+    if(!create(section))
+    {
+        _supported = false;
+        return;
+    }
+
+    // all sections are in flight, drop the oldest one
+    if(section.pending)
+    {
+        section.pending = false;
+        _oldest = (_oldest + 1) % NUM_SECTIONS;
+    }
+
+    section.tag = tag;
+#if !defined(QT_OPENGL_ES_2)
+    section.start->recordTimestamp();
+#endif
+    _started = true;
+}
+
+void GpuTimer::end()
+{
+    if(!_started)
+        return;
+
+    Section& section = _sections[_next];
+#if !defined(QT_OPENGL_ES_2)
+    section.end->recordTimestamp();
+#endif
+    section.pending = true;
+    _started = false;
+    _next = (_next + 1) % NUM_SECTIONS;
+}
+
+bool GpuTimer::takeResult(int& tag, double& seconds)
+{
+#if !defined(QT_OPENGL_ES_2)
+    Section& section = _sections[_oldest];
+
+    if(!section.pending || !section.start->isResultAvailable() || !section.end->isResultAvailable())
+        return false;
+
+    GLuint64 startTime = section.start->waitForTimestamp();
+    GLuint64 endTime = section.end->waitForTimestamp();
+    section.pending = false;
+    _oldest = (_oldest + 1) % NUM_SECTIONS;
+
+    tag = section.tag;
+    seconds = endTime > startTime ? (endTime - startTime) * 1.0e-9 : 0.0;
+    _averageTime = _averageTime > 0.0 ? 0.9 * _averageTime + 0.1 * seconds : seconds;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void GpuTimer::release()
+{
+    _sections.clear();
+    _sections.resize(NUM_SECTIONS);
+    _next = _oldest = 0;
+    _started = false;
+}
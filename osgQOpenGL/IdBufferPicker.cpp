@@ -0,0 +1,338 @@
+#include <osgQOpenGL/IdBufferPicker>
+
+#include <osg/BufferObject>
+#include <osg/FrameBufferObject>
+#include <osg/GLExtensions>
+#include <osg/Program>
+#include <osg/Uniform>
+
+#include <algorithm>
+#include <climits>
+
+#ifndef GL_R32UI
+#define GL_R32UI 0x8236
+#endif
+
+#ifndef GL_RED_INTEGER
+#define GL_RED_INTEGER 0x8D94
+#endif
+
+namespace
+{
+    const char* ID_VERTEX_SHADER =
+        "#version 130\n"
+        "void main()\n"
+        "{\n"
+        "    gl_Position = gl_ModelViewProjectionMatrix * gl_Vertex;\n"
+        "}\n";
+
+    const char* ID_FRAGMENT_SHADER =
+        "#version 130\n"
+        "uniform uint osg_PickId;\n"
+        "out uvec4 fragId;\n"
+        "void main()\n"
+        "{\n"
+        "    fragId = uvec4(osg_PickId, 0u, 0u, 0u);\n"
+        "}\n";
+
+    // readbacks still in flight, a pick needs at most this many frames
+    const std::size_t MAX_READBACKS = 3;
+}
+
+IdBufferPicker::IdBufferPicker() :
+    _pickRadius(2),
+    _requestPending(false),
+    _nextRequestId(1),
+    _table(new IdTable)
+{
+    _texture = new osg::Texture2D();
+    _texture->setTextureSize(1, 1);
+    _texture->setInternalFormat(GL_R32UI);
+    _texture->setSourceFormat(GL_RED_INTEGER);
+    _texture->setSourceType(GL_UNSIGNED_INT);
+    _texture->setFilter(osg::Texture::MIN_FILTER, osg::Texture::NEAREST);
+    _texture->setFilter(osg::Texture::MAG_FILTER, osg::Texture::NEAREST);
+
+    _camera = new osg::Camera();
+    _camera->setName("IdBufferPicker");
+    _camera->setRenderOrder(osg::Camera::PRE_RENDER);
+    _camera->setRenderTargetImplementation(osg::Camera::FRAME_BUFFER_OBJECT);
+    _camera->setReferenceFrame(osg::Transform::RELATIVE_RF);
+    _camera->setViewport(0, 0, 1, 1);
+    _camera->setComputeNearFarMode(osg::CullSettings::DO_NOT_COMPUTE_NEAR_FAR);
+    // id 0 is the background, a float clear of 0 gives 0 in the integer buffer
+    _camera->setClearColor(osg::Vec4(0.0f, 0.0f, 0.0f, 0.0f));
+    _camera->setClearMask(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    _camera->attach(osg::Camera::COLOR_BUFFER0, _texture.get());
+    _camera->attach(osg::Camera::DEPTH_BUFFER, GL_DEPTH_COMPONENT24);
+    _camera->setNodeMask(0);
+
+    osg::Program* program = new osg::Program();
+    program->setName("IdBufferPicker");
+    program->addShader(new osg::Shader(osg::Shader::VERTEX, ID_VERTEX_SHADER));
+    program->addShader(new osg::Shader(osg::Shader::FRAGMENT, ID_FRAGMENT_SHADER));
+
+    // the program of the scene and its blending must not reach the id buffer
+    osg::StateSet* stateSet = _camera->getOrCreateStateSet();
+    stateSet->setAttributeAndModes(program, osg::StateAttribute::ON |
+                                   osg::StateAttribute::OVERRIDE | osg::StateAttribute::PROTECTED);
+    stateSet->setMode(GL_BLEND, osg::StateAttribute::OFF | osg::StateAttribute::OVERRIDE |
+                      osg::StateAttribute::PROTECTED);
+    stateSet->addUniform(new osg::Uniform("osg_PickId", 0u));
+}
+
+IdBufferPicker::~IdBufferPicker()
+{
+    // the buffers and syncs are deleted by releaseGLObjects(), which needs the context
+}
+
+void IdBufferPicker::setScene(osg::Node* scene)
+{
+    if(_camera->getNumChildren() == 1 && _camera->getChild(0) == scene)
+        return;
+
+    _camera->removeChildren(0, _camera->getNumChildren());
+
+    if(scene)
+        _camera->addChild(scene);
+}
+
+void IdBufferPicker::resize(int width, int height)
+{
+    width = std::max(width, 1);
+    height = std::max(height, 1);
+
+    if(_texture->getTextureWidth() == width && _texture->getTextureHeight() == height)
+        return;
+
+    _texture->setTextureSize(width, height);
+    _texture->dirtyTextureObject();
+    _camera->setViewport(0, 0, width, height);
+    _camera->dirtyAttachmentMap();
+}
+
+unsigned int IdBufferPicker::pick(int x, int y)
+{
+    _request.id = _nextRequestId++;
+    _request.x = x;
+    _request.y = y;
+    _request.tick = osg::Timer::instance()->tick();
+    _requestPending = true;
+
+    return _request.id;
+}
+
+void IdBufferPicker::update()
+{
+    // the readbacks in flight need no id buffer, their fences are polled after the frame
+    _camera->setNodeMask(_requestPending && _readbacks.size() < MAX_READBACKS ? ~0u : 0u);
+}
+
+bool IdBufferPicker::prepareFrame(osg::Camera& mainCamera, osg::Node* scene)
+{
+    if(!mainCamera.containsNode(_camera.get()))
+        mainCamera.addChild(_camera.get());
+
+    setScene(scene);
+
+    if(mainCamera.getViewport())
+        resize(mainCamera.getViewport()->width(), mainCamera.getViewport()->height());
+
+    osg::Node::NodeMask nodeMask = _camera->getNodeMask();
+    update();
+
+    return _camera->getNodeMask() != nodeMask;
+}
+
+void IdBufferPicker::releaseGLObjects(osg::State* state)
+{
+    if(state)
+    {
+        const osg::GLExtensions* ext = state->get<osg::GLExtensions>();
+
+        for(std::deque<Readback>::const_iterator itr = _readbacks.begin(); itr != _readbacks.end();
+            ++itr)
+        {
+            ext->glDeleteSync(itr->sync);
+            ext->glDeleteBuffers(1, &itr->buffer);
+        }
+
+        if(!_freeBuffers.empty())
+            ext->glDeleteBuffers(_freeBuffers.size(), &_freeBuffers.front());
+    }
+
+    _readbacks.clear();
+    _freeBuffers.clear();
+    _requestPending = false;
+
+    // the scene's objects belong to the main camera
+    _camera->removeChildren(0, _camera->getNumChildren());
+    _camera->releaseGLObjects(state);
+    _texture->releaseGLObjects(state);
+}
+
+bool IdBufferPicker::takeResult(Result& result)
+{
+    if(_results.empty())
+        return false;
+
+    result = _results.front();
+    _results.pop_front();
+    return true;
+}
+
+void IdBufferPicker::beginCull()
+{
+    // tables of the readbacks in flight stay with them
+    _table = new IdTable;
+}
+
+osg::StateSet* IdBufferPicker::registerDrawable(const osg::NodePath& nodePath)
+{
+    _table->nodePaths.push_back(RefNodePath(nodePath.begin(), nodePath.end()));
+    unsigned int id = _table->nodePaths.size();
+
+    // the state set of an id never changes, they are shared by all frames
+    while(_stateSets.size() < id)
+    {
+        osg::StateSet* stateSet = new osg::StateSet();
+        stateSet->addUniform(new osg::Uniform("osg_PickId", static_cast<unsigned int>
+                                              (_stateSets.size() + 1)));
+        _stateSets.push_back(stateSet);
+    }
+
+    return _stateSets[id - 1].get();
+}
+
+void IdBufferPicker::operator()(osg::RenderInfo& renderInfo, RenderStageEx& stage)
+{
+    osg::State& state = *renderInfo.getState();
+    const osg::GLExtensions* ext = state.get<osg::GLExtensions>();
+
+    if(!ext->isPBOSupported || !ext->glFenceSync)
+        return;
+
+    if(_requestPending && _readbacks.size() < MAX_READBACKS && stage.getFrameBufferObject())
+    {
+        startReadback(state, stage);
+        _requestPending = false;
+    }
+}
+
+void IdBufferPicker::startReadback(osg::State& state, RenderStageEx& stage)
+{
+    const osg::GLExtensions* ext = state.get<osg::GLExtensions>();
+
+    int width = _texture->getTextureWidth();
+    int height = _texture->getTextureHeight();
+
+    Readback readback;
+    readback.request = _request;
+    readback.table = _table;
+
+    int x0 = osg::clampBetween(_request.x - _pickRadius, 0, width - 1);
+    int y0 = osg::clampBetween(_request.y - _pickRadius, 0, height - 1);
+    int x1 = osg::clampBetween(_request.x + _pickRadius, 0, width - 1);
+    int y1 = osg::clampBetween(_request.y + _pickRadius, 0, height - 1);
+    readback.x = x0;
+    readback.y = y0;
+    readback.width = x1 - x0 + 1;
+    readback.height = y1 - y0 + 1;
+
+    if(_freeBuffers.empty())
+    {
+        GLuint buffer = 0;
+        ext->glGenBuffers(1, &buffer);
+        _freeBuffers.push_back(buffer);
+    }
+
+    readback.buffer = _freeBuffers.back();
+    _freeBuffers.pop_back();
+
+    GLsizeiptr size = (2 * _pickRadius + 1) * (2 * _pickRadius + 1) * sizeof(GLuint);
+
+    stage.getFrameBufferObject()->apply(state, osg::FrameBufferObject::READ_FRAMEBUFFER);
+    glReadBuffer(GL_COLOR_ATTACHMENT0_EXT);
+
+    ext->glBindBuffer(GL_PIXEL_PACK_BUFFER_ARB, readback.buffer);
+    ext->glBufferData(GL_PIXEL_PACK_BUFFER_ARB, size, 0, GL_STREAM_READ_ARB);
+    glReadPixels(x0, y0, readback.width, readback.height, GL_RED_INTEGER, GL_UNSIGNED_INT, 0);
+    ext->glBindBuffer(GL_PIXEL_PACK_BUFFER_ARB, 0);
+
+    readback.sync = ext->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    GLuint defaultFbo = state.getGraphicsContext() ? state.getGraphicsContext()->getDefaultFboId() :
+                        0;
+    ext->glBindFramebuffer(GL_READ_FRAMEBUFFER_EXT, defaultFbo);
+
+    _readbacks.push_back(readback);
+}
+
+void IdBufferPicker::collectReadbacks(osg::State& state)
+{
+    const osg::GLExtensions* ext = state.get<osg::GLExtensions>();
+
+    while(!_readbacks.empty())
+    {
+        Readback& readback = _readbacks.front();
+
+        // the fences are signaled in order, the first one still pending ends the poll
+        GLenum status = ext->glClientWaitSync(readback.sync, 0, 0);
+
+        if(status == GL_TIMEOUT_EXPIRED)
+            break;
+
+        ext->glDeleteSync(readback.sync);
+
+        Result result;
+        result.requestId = readback.request.id;
+        result.x = readback.request.x;
+        result.y = readback.request.y;
+
+        if(status != GL_WAIT_FAILED)
+        {
+            ext->glBindBuffer(GL_PIXEL_PACK_BUFFER_ARB, readback.buffer);
+            const GLuint* ids = static_cast<const GLuint*>(ext->glMapBuffer(GL_PIXEL_PACK_BUFFER_ARB,
+                                                                            GL_READ_ONLY_ARB));
+
+            if(ids)
+            {
+                // closest id to the requested position
+                int cx = readback.request.x - readback.x;
+                int cy = readback.request.y - readback.y;
+                int nearest = INT_MAX;
+
+                for(int y = 0; y < readback.height; ++y)
+                {
+                    for(int x = 0; x < readback.width; ++x)
+                    {
+                        GLuint id = ids[y * readback.width + x];
+                        int distance = (x - cx) * (x - cx) + (y - cy) * (y - cy);
+
+                        if(id != 0 && distance < nearest)
+                        {
+                            nearest = distance;
+                            result.id = id;
+                        }
+                    }
+                }
+
+                ext->glUnmapBuffer(GL_PIXEL_PACK_BUFFER_ARB);
+            }
+
+            ext->glBindBuffer(GL_PIXEL_PACK_BUFFER_ARB, 0);
+        }
+
+        if(result.id > 0 && result.id <= readback.table->nodePaths.size())
+            result.nodePath = readback.table->nodePaths[result.id - 1];
+        else
+            result.id = 0;
+
+        result.latency = osg::Timer::instance()->delta_s(readback.request.tick,
+                                                         osg::Timer::instance()->tick());
+        _results.push_back(result);
+
+        _freeBuffers.push_back(readback.buffer);
+        _readbacks.pop_front();
+    }
+}
@@ -0,0 +1,91 @@
+#include <osgQOpenGL/InputLatencyMonitor>
+
+#include <algorithm>
+#include <cmath>
+
+InputLatencyMonitor::InputLatencyMonitor() :
+    _maxSamples(4096),
+    _next(0),
+    _lastLatency(0.0)
+{
+}
+
+InputLatencyMonitor::~InputLatencyMonitor()
+{
+}
+
+void InputLatencyMonitor::addInput(osg::Timer_t tick)
+{
+    _pending.push_back(tick);
+}
+
+void InputLatencyMonitor::beginFrame()
+{
+    _consumed.insert(_consumed.end(), _pending.begin(), _pending.end());
+    _pending.clear();
+}
+
+void InputLatencyMonitor::present(osg::Timer_t tick)
+{
+    _lastLatency = 0.0;
+
+    for(std::vector<osg::Timer_t>::const_iterator itr = _consumed.begin(); itr != _consumed.end(); ++itr)
+    {
+        double latency = osg::Timer::instance()->delta_s(*itr, tick);
+        _lastLatency = std::max(_lastLatency, latency);
+
+        if(_samples.size() < _maxSamples)
+        {
+            _samples.push_back(latency);
+        }
+        else
+        {
+            _samples[_next] = latency;
+            _next = (_next + 1) % _maxSamples;
+        }
+    }
+
+    _consumed.clear();
+}
+
+void InputLatencyMonitor::setMaxSamples(unsigned int samples)
+{
+    _maxSamples = std::max(samples, 1u);
+
+    // oldest first, then keep the latest ones
+    std::rotate(_samples.begin(), _samples.begin() + _next, _samples.end());
+    _next = 0;
+
+    if(_samples.size() > _maxSamples)
+        _samples.erase(_samples.begin(), _samples.end() - _maxSamples);
+}
+
+double InputLatencyMonitor::getPercentile(double percentile) const
+{
+    if(_samples.empty())
+        return 0.0;
+
+    // nearest rank
+    std::vector<double> sorted(_samples);
+    double rank = std::ceil(std::min(std::max(percentile, 0.0), 100.0) / 100.0 * sorted.size());
+    std::vector<double>::iterator nth = sorted.begin() + std::max(static_cast<int>(rank) - 1, 0);
+    std::nth_element(sorted.begin(), nth, sorted.end());
+    return *nth;
+}
+
+void InputLatencyMonitor::reset()
+{
+    _pending.clear();
+    _consumed.clear();
+    _samples.clear();
+    _next = 0;
+    _lastLatency = 0.0;
+}
+
+void InputLatencyMonitor::reportStats(osg::Stats& stats, unsigned int frameNumber) const
+{
+    stats.setAttribute(frameNumber, "Input latency", _lastLatency);
+    stats.setAttribute(frameNumber, "Input latency p50", getPercentile(50.0));
+    stats.setAttribute(frameNumber, "Input latency p95", getPercentile(95.0));
+    stats.setAttribute(frameNumber, "Input latency p99", getPercentile(99.0));
+}
@@ -0,0 +1,253 @@
+#include <osgQOpenGL/InputRecorder>
+
+#include <osgViewer/GraphicsWindow>
+#include <osg/Notify>
+
+#include <cstring>
+
+namespace
+{
+    const char MAGIC[4] = { 'O', 'Q', 'I', 'R' };
+    const unsigned int VERSION = 1;
+
+    // type, mod key mask, frame, time, x, y, a, b
+    const std::size_t EVENT_SIZE = 1 + 2 + 4 + 8 + 4 + 4 + 4 + 4;
+
+    template<typename T>
+    char* put(char* data, T value)
+    {
+        std::memcpy(data, &value, sizeof(T));
+        return data + sizeof(T);
+    }
+
+    template<typename T>
+    const char* get(const char* data, T& value)
+    {
+        std::memcpy(&value, data, sizeof(T));
+        return data + sizeof(T);
+    }
+}
+
+InputRecorder::InputRecorder() :
+    _frame(0),
+    _replaying(false),
+    _timing(REAL_TIME),
+    _fixedFrameTime(1.0 / 60.0),
+    _nextEvent(0),
+    _replayFrame(0)
+{
+}
+
+InputRecorder::~InputRecorder()
+{
+    stopRecording();
+}
+
+bool InputRecorder::startRecording(const std::string& fileName)
+{
+    stopRecording();
+
+    _output.open(fileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+
+    if(!_output)
+    {
+        OSG_WARN << "InputRecorder: cannot write " << fileName << std::endl;
+        return false;
+    }
+
+    _output.write(MAGIC, sizeof(MAGIC));
+    _output.write(reinterpret_cast<const char*>(&VERSION), sizeof(VERSION));
+
+    _frame = 0;
+    _timer.setStartTick();
+
+    return true;
+}
+
+void InputRecorder::stopRecording()
+{
+    if(_output.is_open())
+        _output.close();
+}
+
+void InputRecorder::record(EventType type, unsigned int modKeyMask, float x, float y, int a, int b)
+{
+    if(!_output.is_open())
+        return;
+
+    char data[EVENT_SIZE];
+    char* ptr = data;
+    ptr = put(ptr, static_cast<unsigned char>(type));
+    ptr = put(ptr, static_cast<unsigned short>(modKeyMask));
+    ptr = put(ptr, _frame);
+    ptr = put(ptr, _timer.time_s());
+    ptr = put(ptr, x);
+    ptr = put(ptr, y);
+    ptr = put(ptr, a);
+    put(ptr, b);
+
+    _output.write(data, EVENT_SIZE);
+}
+
+bool InputRecorder::startReplay(const std::string& fileName, Timing timing)
+{
+    stopReplay();
+
+    std::ifstream input(fileName.c_str(), std::ios::in | std::ios::binary);
+    char magic[4];
+    unsigned int version = 0;
+
+    if(!input.read(magic, sizeof(magic))
+       || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0
+       || !input.read(reinterpret_cast<char*>(&version), sizeof(version))
+       || version != VERSION)
+    {
+        OSG_WARN << "InputRecorder: " << fileName << " is not an input recording" << std::endl;
+        return false;
+    }
+
+    _events.clear();
+
+    char data[EVENT_SIZE];
+
+    while(input.read(data, EVENT_SIZE))
+    {
+        Event event;
+        const char* ptr = data;
+        ptr = get(ptr, event.type);
+        ptr = get(ptr, event.modKeyMask);
+        ptr = get(ptr, event.frame);
+        ptr = get(ptr, event.time);
+        ptr = get(ptr, event.x);
+        ptr = get(ptr, event.y);
+        ptr = get(ptr, event.a);
+        get(ptr, event.b);
+        _events.push_back(event);
+    }
+
+    _timing = timing;
+    _nextEvent = 0;
+    _replayFrame = 0;
+    _frameTimings.clear();
+    _timer.setStartTick();
+    _replaying = true;
+
+    return true;
+}
+
+void InputRecorder::stopReplay()
+{
+    _replaying = false;
+    _events.clear();
+}
+
+bool InputRecorder::replayFrame(osgViewer::GraphicsWindow* window, double& simulationTime)
+{
+    if(!_replaying)
+        return false;
+
+    if(_nextEvent >= _events.size())
+    {
+        _replaying = false;
+        return false;
+    }
+
+    double time = _timer.time_s();
+
+    // the events of a FIXED_TIME replay are stamped with the fixed clock, so that the
+    // motion of the manipulators does not depend on how long the frames took
+    double eventTime = _timing == FIXED_TIME ? _replayFrame * _fixedFrameTime :
+                       window->getEventQueue()->getTime();
+
+    while(_nextEvent < _events.size())
+    {
+        const Event& event = _events[_nextEvent];
+
+        if(_timing == FIXED_TIME ? event.frame > _replayFrame : event.time > time)
+            break;
+
+        inject(window, event, eventTime);
+        ++_nextEvent;
+    }
+
+    if(_timing == FIXED_TIME)
+        simulationTime = eventTime;
+
+    ++_replayFrame;
+
+    return true;
+}
+
+void InputRecorder::inject(osgViewer::GraphicsWindow* window, const Event& event, double time)
+{
+    osgGA::EventQueue* eventQueue = window->getEventQueue();
+    eventQueue->getCurrentEventState()->setModKeyMask(event.modKeyMask);
+
+    switch(event.type)
+    {
+    case KEY_PRESS:
+        eventQueue->keyPress(event.a, time, event.b);
+        break;
+
+    case KEY_RELEASE:
+        eventQueue->keyRelease(event.a, time, event.b);
+        break;
+
+    case MOUSE_PRESS:
+        eventQueue->mouseButtonPress(event.x, event.y, event.a, time);
+        break;
+
+    case MOUSE_RELEASE:
+        eventQueue->mouseButtonRelease(event.x, event.y, event.a, time);
+        break;
+
+    case MOUSE_DOUBLE_CLICK:
+        eventQueue->mouseDoubleButtonPress(event.x, event.y, event.a, time);
+        break;
+
+    case MOUSE_MOTION:
+        eventQueue->mouseMotion(event.x, event.y, time);
+        break;
+
+    case SCROLL:
+        eventQueue->mouseMotion(event.x, event.y, time);
+        eventQueue->mouseScroll(static_cast<osgGA::GUIEventAdapter::ScrollingMotion>(event.a), time);
+        break;
+
+    case RESIZE:
+        eventQueue->windowResize(0, 0, static_cast<int>(event.x), static_cast<int>(event.y), time);
+        window->resized(0, 0, static_cast<int>(event.x), static_cast<int>(event.y));
+        break;
+
+    default:
+        break;
+    }
+}
+
+void InputRecorder::addFrameTiming(double seconds)
+{
+    FrameTiming timing;
+    timing.frame = _replayFrame > 0 ? _replayFrame - 1 : 0;
+    timing.time = _timer.time_s();
+    timing.duration = seconds;
+    _frameTimings.push_back(timing);
+}
+
+bool InputRecorder::writeFrameTimings(const std::string& fileName) const
+{
+    std::ofstream output(fileName.c_str());
+
+    if(!output)
+        return false;
+
+    output << "frame,time,duration" << std::endl;
+
+    for(std::vector<FrameTiming>::const_iterator itr = _frameTimings.begin();
+        itr != _frameTimings.end();
+        ++itr)
+    {
+        output << itr->frame << "," << itr->time << "," << itr->duration << std::endl;
+    }
+
+    return static_cast<bool>(output);
+}
@@ -0,0 +1,245 @@
+#include <osgQOpenGL/InstanceBatcher>
+
+#include <osgUtil/StateGraph>
+#include <osg/Program>
+
+#include <algorithm>
+
+namespace
+{
+    // leaves drawing the same geometry with the same projection end up next to each other.
+    struct LeafBatchOrder
+    {
+        bool operator()(const osgUtil::RenderLeaf* lhs, const osgUtil::RenderLeaf* rhs) const
+        {
+            const osg::Drawable* ld = lhs->_drawable;
+            const osg::Drawable* rd = rhs->_drawable;
+
+            if(ld != rd)
+                return ld < rd;
+
+            return lhs->_projection.get() < rhs->_projection.get();
+        }
+    };
+
+    bool sameBatch(const osgUtil::RenderLeaf* lhs, const osgUtil::RenderLeaf* rhs)
+    {
+        return static_cast<const osg::Drawable*>(lhs->_drawable) ==
+               static_cast<const osg::Drawable*>(rhs->_drawable)
+               && lhs->_projection.get() == rhs->_projection.get();
+    }
+}
+
+InstanceBatcher::InstanceBatcher() :
+    _instanceMatrixAttribute("osg_InstanceMatrix"),
+    _minimumInstances(4)
+{
+}
+
+void InstanceBatcher::reportStats(osg::Stats& stats, unsigned int frameNumber) const
+{
+    stats.setAttribute(frameNumber, "Instancing draw calls before", _stats.numDrawCallsBefore);
+    stats.setAttribute(frameNumber, "Instancing draw calls after", _stats.numDrawCallsAfter);
+    stats.setAttribute(frameNumber, "Instancing batches", _stats.numBatches);
+    stats.setAttribute(frameNumber, "Instancing instances", _stats.numInstances);
+}
+
+void InstanceBatcher::batch(osgUtil::RenderBin* stage, BatchList& batches)
+{
+    unsigned int numUsed = 0;
+
+    batchBin(stage, batches, numUsed);
+
+    // let go of the geometries and matrices of the batches that are gone.
+    for(unsigned int i = numUsed; i < batches.size(); ++i)
+    {
+        batches[i].drawable->set(0, 0);
+        batches[i].drawable->clearInstances();
+        batches[i].leaf->reset();
+    }
+}
+
+void InstanceBatcher::batchBin(osgUtil::RenderBin* bin, BatchList& batches,
+                               unsigned int& numUsed)
+{
+    for(osgUtil::RenderBin::RenderBinList::iterator itr = bin->getRenderBinList().begin();
+        itr != bin->getRenderBinList().end();
+        ++itr)
+    {
+        batchBin(itr->second.get(), batches, numUsed);
+    }
+
+    _stats.numDrawCallsBefore += bin->getRenderLeafList().size();
+    _stats.numDrawCallsAfter += bin->getRenderLeafList().size();
+
+    bool stateSorted = bin->getSortMode() == osgUtil::RenderBin::SORT_BY_STATE
+                       || bin->getSortMode() == osgUtil::RenderBin::SORT_BY_STATE_THEN_FRONT_TO_BACK;
+
+    for(osgUtil::RenderBin::StateGraphList::iterator itr = bin->getStateGraphList().begin();
+        itr != bin->getStateGraphList().end();
+        ++itr)
+    {
+        osgUtil::StateGraph* sg = *itr;
+        GLuint location = 0;
+
+        _stats.numDrawCallsBefore += sg->_leaves.size();
+
+        if(stateSorted
+           && sg->_leaves.size() >= _minimumInstances
+           && getInstanceMatrixLocation(sg, location))
+        {
+            batchStateGraph(sg, location, batches, numUsed);
+        }
+
+        _stats.numDrawCallsAfter += sg->_leaves.size();
+    }
+}
+
+void InstanceBatcher::batchStateGraph(osgUtil::StateGraph* sg, GLuint location,
+                                      BatchList& batches, unsigned int& numUsed)
+{
+    _candidates.clear();
+
+    osgUtil::StateGraph::LeafList leaves;
+    leaves.swap(sg->_leaves);
+
+    for(osgUtil::StateGraph::LeafList::iterator itr = leaves.begin(); itr != leaves.end(); ++itr)
+    {
+        if(isBatchable(itr->get()))
+            _candidates.push_back(itr->get());
+        else
+            sg->_leaves.push_back(*itr);
+    }
+
+    std::sort(_candidates.begin(), _candidates.end(), LeafBatchOrder());
+
+    std::size_t begin = 0;
+
+    while(begin < _candidates.size())
+    {
+        std::size_t end = begin + 1;
+
+        while(end < _candidates.size() && sameBatch(_candidates[begin], _candidates[end]))
+        {
+            ++end;
+        }
+
+        if(end - begin < _minimumInstances)
+        {
+            for(std::size_t i = begin; i < end; ++i)
+            {
+                sg->_leaves.push_back(_candidates[i]);
+            }
+
+            begin = end;
+            continue;
+        }
+
+        if(numUsed == batches.size())
+        {
+            Batch batch;
+            batch.drawable = new InstancedDrawable();
+            batch.leaf = new osgUtil::RenderLeaf(0, 0, 0, 0.0f);
+            batches.push_back(batch);
+        }
+
+        Batch& batch = batches[numUsed++];
+        InstancedDrawable* drawable = batch.drawable.get();
+        osgUtil::RenderLeaf* first = _candidates[begin];
+
+        drawable->set(static_cast<osg::Geometry*>(static_cast<osg::Drawable*>(first->_drawable)),
+                      location);
+        drawable->clearInstances();
+
+        // the batch is drawn with the model view matrix of its first leaf, the others
+        // are placed relative to it.
+        osg::Matrix inverse = osg::Matrix::inverse(*first->_modelview);
+        float depth = first->_depth;
+
+        for(std::size_t i = begin; i < end; ++i)
+        {
+            drawable->addInstance(*_candidates[i]->_modelview * inverse);
+            depth = std::min(depth, _candidates[i]->_depth);
+        }
+
+        batch.leaf->set(drawable, first->_projection.get(), first->_modelview.get(), depth,
+                        first->_traversalOrderNumber);
+        sg->addLeaf(batch.leaf.get());
+
+        ++_stats.numBatches;
+        _stats.numInstances += end - begin;
+
+        begin = end;
+    }
+}
+
+bool InstanceBatcher::getInstanceMatrixLocation(const osgUtil::StateGraph* sg, GLuint& location)
+{
+    // the program closest to the leaves is the one they are drawn with.
+    for(; sg; sg = sg->_parent)
+    {
+        const osg::StateSet* stateSet = sg->getStateSet();
+        const osg::Program* program = stateSet ? dynamic_cast<const osg::Program*>
+                                      (stateSet->getAttribute(osg::StateAttribute::PROGRAM)) : 0;
+
+        if(!program)
+            continue;
+
+        osg::Program::AttribBindingList::const_iterator itr = program->getAttribBindingList().find(
+                                                                  _instanceMatrixAttribute);
+
+        if(itr == program->getAttribBindingList().end())
+            return false;
+
+        location = itr->second;
+        _locations.insert(location);
+        return true;
+    }
+
+    return false;
+}
+
+bool InstanceBatcher::isBatchable(const osgUtil::RenderLeaf* leaf)
+{
+    const osg::Geometry* geometry = dynamic_cast<const osg::Geometry*>
+                                    (static_cast<const osg::Drawable*>(leaf->_drawable));
+
+    if(!geometry || geometry->getDrawCallback() || geometry->containsDeprecatedData()
+       || !leaf->_modelview.valid())
+        return false;
+
+    const osg::Geometry::PrimitiveSetList& primitives = geometry->getPrimitiveSetList();
+
+    for(osg::Geometry::PrimitiveSetList::const_iterator itr = primitives.begin();
+        itr != primitives.end();
+        ++itr)
+    {
+        // primitive sets which are already instanced are drawn as they are, and
+        // InstancedDrawable only issues instanced draws for plain arrays and elements.
+        if((*itr)->getNumInstances() != 0)
+            return false;
+
+        switch((*itr)->getType())
+        {
+        case osg::PrimitiveSet::DrawArraysPrimitiveType:
+        case osg::PrimitiveSet::DrawArrayLengthsPrimitiveType:
+        case osg::PrimitiveSet::DrawElementsUBytePrimitiveType:
+        case osg::PrimitiveSet::DrawElementsUShortPrimitiveType:
+        case osg::PrimitiveSet::DrawElementsUIntPrimitiveType:
+            break;
+
+        default:
+            return false;
+        }
+    }
+
+    return !primitives.empty();
+}
+
+void InstanceBatcher::resetInstanceMatrices(osg::State& state) const
+{
+    for(std::set<GLuint>::const_iterator itr = _locations.begin(); itr != _locations.end(); ++itr)
+    {
+        InstancedDrawable::resetInstanceMatrix(state, *itr);
+    }
+}
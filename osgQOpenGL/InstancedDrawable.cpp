@@ -0,0 +1,246 @@
+#include <osgQOpenGL/InstancedDrawable>
+
+#include <osg/BufferObject>
+#include <osg/GLExtensions>
+#include <osg/State>
+#include <osg/PrimitiveSet>
+
+InstancedDrawable::InstancedDrawable() :
+    _location(0),
+    _instanceMatrices(new osg::MatrixfArray)
+{
+    setUseDisplayList(false);
+    setUseVertexArrayObject(false);
+    setDataVariance(osg::Object::DYNAMIC);
+
+    osg::VertexBufferObject* vbo = new osg::VertexBufferObject();
+    vbo->setUsage(GL_STREAM_DRAW_ARB);
+    _instanceMatrices->setBufferObject(vbo);
+}
+
+InstancedDrawable::InstancedDrawable(const InstancedDrawable& drawable,
+                                     const osg::CopyOp& copyop) :
+    osg::Drawable(drawable, copyop),
+    _geometry(drawable._geometry),
+    _location(drawable._location),
+    _instanceMatrices(new osg::MatrixfArray(*drawable._instanceMatrices))
+{
+    osg::VertexBufferObject* vbo = new osg::VertexBufferObject();
+    vbo->setUsage(GL_STREAM_DRAW_ARB);
+    _instanceMatrices->setBufferObject(vbo);
+}
+
+void InstancedDrawable::set(osg::Geometry* geometry, GLuint location)
+{
+    _geometry = geometry;
+    _location = location;
+    dirtyBound();
+}
+
+void InstancedDrawable::clearInstances()
+{
+    _instanceMatrices->clear();
+}
+
+void InstancedDrawable::addInstance(const osg::Matrix& matrix)
+{
+    _instanceMatrices->push_back(osg::Matrixf(matrix));
+    _instanceMatrices->dirty();
+}
+
+osg::BoundingBox InstancedDrawable::computeBoundingBox() const
+{
+    osg::BoundingBox bb;
+
+    if(!_geometry)
+        return bb;
+
+    const osg::BoundingBox& gbb = _geometry->getBoundingBox();
+
+    for(osg::MatrixfArray::const_iterator itr = _instanceMatrices->begin();
+        itr != _instanceMatrices->end();
+        ++itr)
+    {
+        for(unsigned int i = 0; i < 8; ++i)
+        {
+            bb.expandBy(gbb.corner(i) * (*itr));
+        }
+    }
+
+    return bb;
+}
+
+void InstancedDrawable::drawImplementation(osg::RenderInfo& renderInfo) const
+{
+    if(!_geometry || _instanceMatrices->empty())
+        return;
+
+    osg::State& state = *renderInfo.getState();
+    const osg::GLExtensions* ext = state.get<osg::GLExtensions>();
+
+    // a vertex array object of the geometry would replace the instance attribute arrays.
+    bool instanced = ext->isBufferObjectSupported
+                     && ext->glVertexAttribDivisor
+                     && ext->glDrawArraysInstanced
+                     && ext->glDrawElementsInstanced
+                     && !state.useVertexArrayObject(_geometry->getUseVertexArrayObject());
+
+    if(instanced)
+        drawInstanced(state, renderInfo);
+    else
+        drawSeparately(state, renderInfo);
+
+    resetInstanceMatrix(state, _location);
+}
+
+void InstancedDrawable::drawInstanced(osg::State& state, osg::RenderInfo& renderInfo) const
+{
+    const osg::GLExtensions* ext = state.get<osg::GLExtensions>();
+
+    osg::GLBufferObject* glbo = _instanceMatrices->getOrCreateGLBufferObject(state.getContextID());
+
+    if(glbo->isDirty())
+        glbo->compileBuffer();
+
+    state.bindVertexBufferObject(glbo);
+
+    const char* offset = reinterpret_cast<const char*>(glbo->getOffset(
+                                                           _instanceMatrices->getBufferIndex()));
+
+    for(GLuint i = 0; i < 4; ++i)
+    {
+        ext->glEnableVertexAttribArray(_location + i);
+        ext->glVertexAttribPointer(_location + i, 4, GL_FLOAT, GL_FALSE, sizeof(osg::Matrixf),
+                                   offset + i * 4 * sizeof(float));
+        ext->glVertexAttribDivisor(_location + i, 1);
+    }
+
+    state.unbindVertexBufferObject();
+
+    // the primitive sets are shared with the geometry's other draws, possibly from
+    // other threads, so the instance count is passed to the draw calls instead of
+    // being set on them.
+    _geometry->drawVertexArraysImplementation(renderInfo);
+
+    const GLsizei numInstances = static_cast<GLsizei>(_instanceMatrices->size());
+    bool usingVertexBufferObjects = state.useVertexBufferObject(
+                                        _geometry->getSupportsVertexBufferObjects()
+                                        && _geometry->getUseVertexBufferObjects());
+    const osg::Geometry::PrimitiveSetList& primitives = _geometry->getPrimitiveSetList();
+
+    for(osg::Geometry::PrimitiveSetList::const_iterator itr = primitives.begin();
+        itr != primitives.end();
+        ++itr)
+    {
+        drawPrimitiveSet(state, **itr, numInstances, usingVertexBufferObjects);
+    }
+
+    for(GLuint i = 0; i < 4; ++i)
+    {
+        ext->glVertexAttribDivisor(_location + i, 0);
+        ext->glDisableVertexAttribArray(_location + i);
+    }
+}
+
+void InstancedDrawable::drawPrimitiveSet(osg::State& state, const osg::PrimitiveSet& primitiveSet,
+                                         GLsizei numInstances, bool usingVertexBufferObjects)
+{
+    const osg::GLExtensions* ext = state.get<osg::GLExtensions>();
+    GLenum mode = primitiveSet.getMode();
+
+    switch(primitiveSet.getType())
+    {
+    case osg::PrimitiveSet::DrawArraysPrimitiveType:
+    {
+        const osg::DrawArrays& drawArrays = static_cast<const osg::DrawArrays&>(primitiveSet);
+        ext->glDrawArraysInstanced(mode, drawArrays.getFirst(), drawArrays.getCount(), numInstances);
+        break;
+    }
+
+    case osg::PrimitiveSet::DrawArrayLengthsPrimitiveType:
+    {
+        const osg::DrawArrayLengths& lengths = static_cast<const osg::DrawArrayLengths&>
+                                               (primitiveSet);
+        GLint first = lengths.getFirst();
+
+        for(osg::DrawArrayLengths::const_iterator itr = lengths.begin(); itr != lengths.end(); ++itr)
+        {
+            ext->glDrawArraysInstanced(mode, first, *itr, numInstances);
+            first += *itr;
+        }
+
+        break;
+    }
+
+    case osg::PrimitiveSet::DrawElementsUBytePrimitiveType:
+    case osg::PrimitiveSet::DrawElementsUShortPrimitiveType:
+    case osg::PrimitiveSet::DrawElementsUIntPrimitiveType:
+    {
+        const osg::DrawElements* elements = primitiveSet.getDrawElements();
+        GLenum type = primitiveSet.getType() == osg::PrimitiveSet::DrawElementsUBytePrimitiveType ?
+                      GL_UNSIGNED_BYTE :
+                      (primitiveSet.getType() == osg::PrimitiveSet::DrawElementsUShortPrimitiveType ?
+                       GL_UNSIGNED_SHORT : GL_UNSIGNED_INT);
+        const GLvoid* indices = elements->getDataPointer();
+        osg::GLBufferObject* ebo = usingVertexBufferObjects ?
+                                   elements->getOrCreateGLBufferObject(state.getContextID()) : 0;
+
+        if(ebo)
+        {
+            state.getCurrentVertexArrayState()->bindElementBufferObject(ebo);
+            indices = reinterpret_cast<const GLvoid*>(ebo->getOffset(elements->getBufferIndex()));
+        }
+        else
+        {
+            state.getCurrentVertexArrayState()->unbindElementBufferObject();
+        }
+
+        ext->glDrawElementsInstanced(mode, elements->getNumIndices(), type, indices, numInstances);
+        break;
+    }
+
+    default:
+        // InstanceBatcher only batches geometries made of the types above.
+        break;
+    }
+}
+
+void InstancedDrawable::drawSeparately(osg::State& state, osg::RenderInfo& renderInfo) const
+{
+    const osg::GLExtensions* ext = state.get<osg::GLExtensions>();
+
+    for(osg::MatrixfArray::const_iterator itr = _instanceMatrices->begin();
+        itr != _instanceMatrices->end();
+        ++itr)
+    {
+        for(GLuint i = 0; i < 4; ++i)
+        {
+            ext->glVertexAttrib4fv(_location + i, itr->ptr() + i * 4);
+        }
+
+        _geometry->draw(renderInfo);
+    }
+}
+
+void InstancedDrawable::resetInstanceMatrix(osg::State& state, GLuint location)
+{
+    const osg::GLExtensions* ext = state.get<osg::GLExtensions>();
+
+    for(GLuint i = 0; i < 4; ++i)
+    {
+        ext->glVertexAttrib4f(location + i, i == 0 ? 1.0f : 0.0f, i == 1 ? 1.0f : 0.0f,
+                              i == 2 ? 1.0f : 0.0f, i == 3 ? 1.0f : 0.0f);
+    }
+}
+
+void InstancedDrawable::resizeGLObjectBuffers(unsigned int maxSize)
+{
+    osg::Drawable::resizeGLObjectBuffers(maxSize);
+    _instanceMatrices->resizeGLObjectBuffers(maxSize);
+}
+
+void InstancedDrawable::releaseGLObjects(osg::State* state) const
+{
+    osg::Drawable::releaseGLObjects(state);
+    _instanceMatrices->releaseGLObjects(state);
+}
@@ -0,0 +1,222 @@
+#include <osgQOpenGL/ModelLoader>
+#include <osgQOpenGL/OSGRenderer>
+
+#include <osgDB/ReadFile>
+#include <osgUtil/Optimizer>
+
+#include <QRunnable>
+
+class ModelLoader::LoadTask : public QRunnable
+{
+public:
+    LoadTask(ModelLoader* loader, ModelLoadHandle* handle) :
+        _loader(loader),
+        _handle(handle),
+        _shared(handle->_shared),
+        _path(handle->path().toLocal8Bit().toStdString()),
+        _options(loader->_options),
+        _optimize(loader->_optimize) {}
+
+    void run() override
+    {
+        osg::ref_ptr<osg::Node> node;
+
+        if(!_shared->cancelled)
+        {
+            post(ModelLoadHandle::Reading);
+            node = osgDB::readRefNodeFile(_path, _options.get());
+        }
+
+        if(node.valid() && _optimize && !_shared->cancelled)
+        {
+            post(ModelLoadHandle::Optimizing);
+            osgUtil::Optimizer optimizer;
+            optimizer.optimize(node.get());
+        }
+
+        // the loader outlives its tasks, its destructor waits for them
+        ModelLoader* loader = _loader;
+        ModelLoadHandle* handle = _handle;
+        QMetaObject::invokeMethod(loader, [loader, handle, node]()
+        {
+            loader->readDone(handle, node);
+        }, Qt::QueuedConnection);
+    }
+
+protected:
+    void post(ModelLoadHandle::Status status)
+    {
+        ModelLoader* loader = _loader;
+        ModelLoadHandle* handle = _handle;
+        QMetaObject::invokeMethod(loader, [loader, handle, status]()
+        {
+            loader->setStatus(handle, status);
+        }, Qt::QueuedConnection);
+    }
+
+    ModelLoader*                                _loader;
+    ModelLoadHandle*                            _handle;
+    std::shared_ptr<ModelLoadHandle::Shared>    _shared;
+    std::string                                 _path;
+    osg::ref_ptr<osgDB::Options>                _options;
+    bool                                        _optimize;
+};
+
+ModelLoadHandle::ModelLoadHandle(const QString& path, osg::Group* parent, QObject* owner) :
+    QObject(owner),
+    _path(path),
+    _hasParent(parent != nullptr),
+    _parent(parent),
+    _shared(new Shared)
+{
+}
+
+int ModelLoadHandle::progress() const
+{
+    switch(_status)
+    {
+    case Queued:
+        return 0;
+
+    case Reading:
+        return 10;
+
+    case Optimizing:
+        return 60;
+
+    case Merging:
+        return 90;
+
+    default:
+        return 100;
+    }
+}
+
+void ModelLoadHandle::cancel()
+{
+    _shared->cancelled = true;
+}
+
+void ModelLoadHandle::setStatus(Status status)
+{
+    if(_status == status)
+        return;
+
+    _status = status;
+    emit progressChanged(progress());
+}
+
+void ModelLoadHandle::finish(Status status)
+{
+    setStatus(status);
+    emit finished(status == Loaded);
+    deleteLater();
+}
+
+ModelLoader::ModelLoader(OpenThreads::ReadWriteMutex* mutex, QObject* parent) :
+    QObject(parent),
+    _mutex(mutex)
+{
+}
+
+ModelLoader::~ModelLoader()
+{
+    cancelAll();
+    _pool.waitForDone();
+}
+
+void ModelLoader::setRenderer(OSGRenderer* renderer)
+{
+    _renderer = renderer;
+
+    if(!_renderer)
+        return;
+
+    QList<ModelLoadHandle*> loads = _loads;
+
+    for(QList<ModelLoadHandle*>::iterator itr = loads.begin(); itr != loads.end(); ++itr)
+    {
+        if((*itr)->status() == ModelLoadHandle::Merging)
+            merge(*itr);
+    }
+}
+
+ModelLoadHandle* ModelLoader::load(const QString& path, osg::Group* parent)
+{
+    ModelLoadHandle* handle = new ModelLoadHandle(path, parent, this);
+    _loads.append(handle);
+    _pool.start(new LoadTask(this, handle));
+
+    return handle;
+}
+
+QList<ModelLoadHandle*> ModelLoader::loads() const
+{
+    return _loads;
+}
+
+void ModelLoader::cancelAll()
+{
+    for(QList<ModelLoadHandle*>::iterator itr = _loads.begin(); itr != _loads.end(); ++itr)
+    {
+        (*itr)->cancel();
+    }
+}
+
+void ModelLoader::setStatus(ModelLoadHandle* handle, ModelLoadHandle::Status status)
+{
+    if(!handle->_shared->cancelled)
+        handle->setStatus(status);
+}
+
+void ModelLoader::readDone(ModelLoadHandle* handle, osg::ref_ptr<osg::Node> node)
+{
+    if(handle->_shared->cancelled || !node.valid())
+    {
+        _loads.removeOne(handle);
+        handle->finish(handle->_shared->cancelled ? ModelLoadHandle::Cancelled : ModelLoadHandle::Failed);
+        return;
+    }
+
+    handle->_node = node;
+    handle->setStatus(ModelLoadHandle::Merging);
+
+    if(_renderer)
+        merge(handle);
+}
+
+void ModelLoader::merge(ModelLoadHandle* handle)
+{
+    _loads.removeOne(handle);
+
+    if(handle->_shared->cancelled)
+    {
+        handle->finish(ModelLoadHandle::Cancelled);
+        return;
+    }
+
+    osg::ref_ptr<osg::Group> parent;
+
+    if(handle->_hasParent && !handle->_parent.lock(parent))
+    {
+        handle->finish(ModelLoadHandle::Failed);
+        return;
+    }
+
+    {
+        osg::Timer_t lockTick = osg::Timer::instance()->tick();
+        OpenThreads::ScopedWriteLock lock(*_mutex);
+        _renderer->recordWriteLockWait(osg::Timer::instance()->delta_s(lockTick, osg::Timer::instance()->tick()));
+
+        if(parent.valid())
+            parent->addChild(handle->_node.get());
+        else
+            _renderer->setSceneData(handle->_node.get());
+    }
+
+    _renderer->dirtyScene();
+    _renderer->requestRedraw();
+    _renderer->update();
+
+    handle->finish(ModelLoadHandle::Loaded);
+}
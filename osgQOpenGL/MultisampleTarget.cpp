@@ -0,0 +1,157 @@
+#include <osgQOpenGL/MultisampleTarget>
+#include <osgQOpenGL/FrameTracer>
+
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLFramebufferObject>
+
+#include <algorithm>
+
+#ifndef GL_DEPTH_ATTACHMENT
+#define GL_DEPTH_ATTACHMENT 0x8D00
+#endif
+#ifndef GL_STENCIL_ATTACHMENT
+#define GL_STENCIL_ATTACHMENT 0x8D20
+#endif
+
+MultisampleTarget::MultisampleTarget() :
+    _samples(4),
+    _width(0),
+    _height(0),
+    _targetSamples(0),
+    _invalidateSupported(false),
+    _regionX0(0),
+    _regionY0(0),
+    _regionX1(0),
+    _regionY1(0)
+{
+}
+
+MultisampleTarget::~MultisampleTarget()
+{
+}
+
+int MultisampleTarget::getActualSamples() const
+{
+    return _target ? _target->format().samples() : 0;
+}
+
+bool MultisampleTarget::begin(QOpenGLContext& context, int width, int height)
+{
+    width = std::max(width, 1);
+    height = std::max(height, 1);
+
+    if(!_target || _width != width || _height != height || _targetSamples != _samples)
+    {
+        QOpenGLFramebufferObjectFormat format;
+        format.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+        format.setSamples(_samples);
+        _target.reset(new QOpenGLFramebufferObject(width, height, format));
+        _width = width;
+        _height = height;
+        _targetSamples = _samples;
+        ++_stats.numReallocations;
+
+        QSurfaceFormat surfaceFormat = context.format();
+        _invalidateSupported = context.isOpenGLES() ?
+                               surfaceFormat.majorVersion() >= 3 :
+                               surfaceFormat.version() >= qMakePair(4, 3)
+                               || context.hasExtension("GL_ARB_invalidate_subdata");
+    }
+
+    _regionX0 = _regionY0 = _regionX1 = _regionY1 = 0;
+
+    return _target->isValid();
+}
+
+GLuint MultisampleTarget::getFramebuffer() const
+{
+    return _target ? _target->handle() : 0;
+}
+
+void MultisampleTarget::addDrawnRegion(const osg::Viewport& viewport)
+{
+    int x0 = std::max(static_cast<int>(viewport.x()), 0);
+    int y0 = std::max(static_cast<int>(viewport.y()), 0);
+    int x1 = std::min(static_cast<int>(viewport.x() + viewport.width()), _width);
+    int y1 = std::min(static_cast<int>(viewport.y() + viewport.height()), _height);
+
+    if(x1 <= x0 || y1 <= y0)
+        return;
+
+    if(_regionX1 <= _regionX0)
+    {
+        _regionX0 = x0;
+        _regionY0 = y0;
+        _regionX1 = x1;
+        _regionY1 = y1;
+    }
+    else
+    {
+        _regionX0 = std::min(_regionX0, x0);
+        _regionY0 = std::min(_regionY0, y0);
+        _regionX1 = std::max(_regionX1, x1);
+        _regionY1 = std::max(_regionY1, y1);
+    }
+}
+
+void MultisampleTarget::resolve(QOpenGLContext& context, GLuint framebuffer)
+{
+    if(!_target)
+        return;
+
+    OSGQOPENGL_TRACE_ZONE("multisample resolve");
+    QOpenGLExtraFunctions* f = context.extraFunctions();
+    GLboolean scissorTest = f->glIsEnabled(GL_SCISSOR_TEST);
+
+    if(scissorTest)
+        f->glDisable(GL_SCISSOR_TEST);
+
+    f->glBindFramebuffer(GL_READ_FRAMEBUFFER, _target->handle());
+
+    // a multisample resolve copies rectangles of the same size
+    if(_regionX1 > _regionX0 && _regionY1 > _regionY0)
+    {
+        f->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+        f->glBlitFramebuffer(_regionX0, _regionY0, _regionX1, _regionY1,
+                             _regionX0, _regionY0, _regionX1, _regionY1,
+                             GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        ++_stats.numResolves;
+        _stats.resolvedPixels += static_cast<unsigned long long>(_regionX1 - _regionX0) * (_regionY1 - _regionY0);
+    }
+
+    _stats.targetPixels += static_cast<unsigned long long>(_width) * _height;
+
+    if(_invalidateSupported)
+    {
+        const GLenum attachments[] = { GL_DEPTH_ATTACHMENT, GL_STENCIL_ATTACHMENT };
+        f->glInvalidateFramebuffer(GL_READ_FRAMEBUFFER, 2, attachments);
+        ++_stats.numInvalidations;
+    }
+
+    f->glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+    if(scissorTest)
+        f->glEnable(GL_SCISSOR_TEST);
+}
+
+void MultisampleTarget::release()
+{
+    _target.reset();
+    _width = _height = 0;
+}
+
+unsigned long long MultisampleTarget::getAllocatedBytes() const
+{
+    // RGBA8 color and packed depth stencil per sample
+    return _target ? 8ull * std::max(getActualSamples(), 1) * _width * _height : 0;
+}
+
+void MultisampleTarget::reportStats(osg::Stats& stats, unsigned int frameNumber) const
+{
+    stats.setAttribute(frameNumber, "Multisample samples", getActualSamples());
+    stats.setAttribute(frameNumber, "Multisample resolves", _stats.numResolves);
+    stats.setAttribute(frameNumber, "Multisample resolved pixels", _stats.resolvedPixels);
+    stats.setAttribute(frameNumber, "Multisample target pixels", _stats.targetPixels);
+    stats.setAttribute(frameNumber, "Multisample invalidations", _stats.numInvalidations);
+}
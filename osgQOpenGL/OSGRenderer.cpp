@@ -20,22 +20,34 @@
 #include <osgQOpenGL/osgQOpenGLWidget>
 #include <osgQOpenGL/osgQOpenGLView>
 
-//#include <osgQOpenGL/CullVisitorEx>
+#include <osgQOpenGL/CullVisitorEx>
+#include <osgQOpenGL/RenderStageEx>
+#include <osgQOpenGL/ModelLoader>
 //#include <osgQOpenGL/GraphicsWindowEx>
 
+#include <osgViewer/Renderer>
+#include <osgUtil/SceneView>
+#include <osgDB/DatabasePager>
+
 #include <QApplication>
+#include <QCursor>
 #include <QScreen>
 #include <QOpenGLContext>
 #include <QOpenGLFunctions>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLFramebufferObject>
 #include <QOpenGLShaderProgram>
 #include <QOpenGLVertexArrayObject>
 
 #include <QKeyEvent>
 #include <QMouseEvent>
 #include <QWheelEvent>
+#include <QTimerEvent>
 
 #include <QThread>
 
+#include <cmath>
+
 namespace
 {
 
@@ -115,6 +127,81 @@ namespace
     };
 
     static QtKeyboardMap s_QtKeyboardMap;
+    class TracingRenderer : public osgViewer::Renderer
+    {
+    public:
+        TracingRenderer(osg::Camera* camera) :
+            osgViewer::Renderer(camera) {}
+
+        void cull() override
+        {
+            OSGQOPENGL_TRACE_ZONE("cull");
+            osgViewer::Renderer::cull();
+        }
+
+        void draw() override
+        {
+            OSGQOPENGL_TRACE_ZONE("draw");
+            osgViewer::Renderer::draw();
+        }
+
+        void cull_draw() override
+        {
+            OSGQOPENGL_TRACE_ZONE("cull_draw");
+            osgViewer::Renderer::cull_draw();
+        }
+    };
+
+    // traces the merges of the pager and hands the merged subgraphs to the program
+    // binary cache
+    class DatabasePagerEx : public osgDB::DatabasePager
+    {
+    public:
+        DatabasePagerEx(const osgDB::DatabasePager& pager) :
+            osgDB::DatabasePager(pager) {}
+
+        osgDB::DatabasePager* clone() const override
+        {
+            DatabasePagerEx* pager = new DatabasePagerEx(*this);
+            pager->_programBinaryCache = _programBinaryCache;
+            return pager;
+        }
+
+        void updateSceneGraph(const osg::FrameStamp& frameStamp) override
+        {
+            OSGQOPENGL_TRACE_ZONE("DatabasePager merge");
+            osgDB::DatabasePager::updateSceneGraph(frameStamp);
+        }
+
+        // called with each loaded subgraph right before it is merged
+        void registerPagedLODs(osg::Node* subgraph, unsigned int frameNumber) override
+        {
+            osgDB::DatabasePager::registerPagedLODs(subgraph, frameNumber);
+
+            osg::ref_ptr<ProgramBinaryCache> programBinaryCache;
+
+            if(subgraph && _programBinaryCache.lock(programBinaryCache))
+                programBinaryCache->addSubgraph(subgraph);
+        }
+
+        osg::observer_ptr<ProgramBinaryCache> _programBinaryCache;
+    };
+
+    class GpuMemoryBudgetCallback : public GpuMemoryMonitor::BudgetCallback
+    {
+    public:
+        GpuMemoryBudgetCallback(OSGRenderer* renderer) :
+            _renderer(renderer) {}
+
+        void operator()(unsigned int contextID, const GpuMemoryMonitor::Usage& usage) override
+        {
+            emit _renderer->gpuMemoryBudgetExceeded(contextID, usage.getTotal());
+        }
+
+    protected:
+        OSGRenderer* _renderer;
+    };
+
 } // namespace
 
 OSGRenderer::OSGRenderer(QObject* parent, WindowType wt)
@@ -129,62 +216,1093 @@ OSGRenderer::OSGRenderer(QObject* parent, WindowType wt)
     //    });
 }
 
-OSGRenderer::OSGRenderer(osg::ArgumentParser* arguments, QObject* parent, WindowType wt)
-    : QObject(parent), osgViewer::Viewer(*arguments), _windowType(wt)
-{
-    //    QObject::connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit,
-    //                     [this]()
-    //    {
-    //        _applicationAboutToQuit = true;
-    //        killTimer(_timerId);
-    //        _timerId = 0;
-    //    });
-}
+OSGRenderer::OSGRenderer(osg::ArgumentParser* arguments, QObject* parent, WindowType wt)
+    : QObject(parent), osgViewer::Viewer(*arguments), _windowType(wt)
+{
+    //    QObject::connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit,
+    //                     [this]()
+    //    {
+    //        _applicationAboutToQuit = true;
+    //        killTimer(_timerId);
+    //        _timerId = 0;
+    //    });
+}
+
+OSGRenderer::~OSGRenderer()
+{
+}
+
+void OSGRenderer::installTracingHooks()
+{
+#ifndef OSGQOPENGL_NO_TRACING
+    // the scene views of a renderer are set up again by each cull, frames are run
+    // single threaded so the renderer can be replaced between two of them
+    if(!dynamic_cast<TracingRenderer*>(_camera->getRenderer()))
+    {
+        _camera->setRenderer(new TracingRenderer(_camera.get()));
+
+        if(_cullVisitorExInstalled)
+        {
+            _cullVisitorExInstalled = false;
+            installCullVisitorEx();
+            applyCullVisitorSettings();
+        }
+    }
+
+    installDatabasePagerEx();
+#endif
+}
+
+bool OSGRenderer::installDatabasePagerEx()
+{
+    if(!getDatabasePager())
+        return false;
+
+    DatabasePagerEx* pager = dynamic_cast<DatabasePagerEx*>(getDatabasePager());
+
+    // a pager which started paging keeps track of the paged nodes, it can not be replaced
+    if(!pager)
+    {
+        if(getDatabasePager()->isRunning())
+            return false;
+
+        pager = new DatabasePagerEx(*getDatabasePager());
+        setDatabasePager(pager);
+    }
+
+    pager->_programBinaryCache = _programBinaryCache.get();
+    return true;
+}
+
+void OSGRenderer::setTracing(bool enabled)
+{
+    if(enabled)
+    {
+        installTracingHooks();
+        FrameTracer::instance()->setThreadName("render");
+        FrameTracer::instance()->start();
+    }
+    else
+    {
+        FrameTracer::instance()->stop();
+    }
+}
+
+bool OSGRenderer::writeTrace(const QString& fileName) const
+{
+    return FrameTracer::instance()->write(fileName.toLocal8Bit().toStdString());
+}
+
+void OSGRenderer::update()
+{
+	switch (_windowType)
+	{
+	case enQGLView:
+	{
+		auto view = (osgQOpenGLView*)parent();
+        view->_osgWantsToRenderFrame = true;
+		view->scene()->update();
+		break;
+	}
+	case enQGLWindow:
+	{
+		auto window = (osgQOpenGLWindow*)parent();
+        window->_osgWantsToRenderFrame = true;
+		window->update();
+		break;
+	}
+	case enQGLWidget:
+	{
+		auto* widget = (osgQOpenGLWidget*)(parent());
+        widget->_osgWantsToRenderFrame = true;
+        widget->update();
+		break;
+	}
+	default:
+		break;
+	}    
+}
+
+void OSGRenderer::setCullResultReuse(osg::Camera* camera, bool enabled)
+{
+    if(!camera)
+        return;
+
+    CullVisitorEx::setCullResultReuse(*camera, enabled);
+
+    // the stage of the main camera is culled by SceneView, not by CullVisitorEx::apply()
+    if(camera == _camera.get())
+    {
+        if(enabled && !_camera->getCullCallback())
+            _camera->setCullCallback(new CullVisitorEx::StageReuseCallback());
+        else if(!enabled && dynamic_cast<CullVisitorEx::StageReuseCallback*>(_camera->getCullCallback()))
+            _camera->setCullCallback(0);
+    }
+
+    if(enabled)
+        installCullVisitorEx();
+
+    applyCullVisitorSettings();
+}
+
+bool OSGRenderer::cullResultReuse(const osg::Camera* camera) const
+{
+    return camera && CullVisitorEx::getCullResultReuse(*camera);
+}
+
+void OSGRenderer::setOcclusionCulling(bool enabled)
+{
+    _occlusionCulling = enabled;
+
+    if(_occlusionCulling)
+    {
+        occlusionBuffer();
+        installCullVisitorEx();
+    }
+
+    applyCullVisitorSettings();
+}
+
+OcclusionBuffer* OSGRenderer::occlusionBuffer()
+{
+    if(!_occlusionBuffer)
+        _occlusionBuffer = new OcclusionBuffer();
+
+    return _occlusionBuffer.get();
+}
+
+void OSGRenderer::setRadixSort(bool enabled)
+{
+    if(enabled == radixSort())
+        return;
+
+    _radixSortCallback = enabled ? new RadixSortCallback() : 0;
+
+    if(enabled)
+        installCullVisitorEx();
+
+    applyCullVisitorSettings();
+}
+
+void OSGRenderer::setInstancing(bool enabled)
+{
+    if(enabled == instancing())
+        return;
+
+    _instanceBatcher = enabled ? new InstanceBatcher() : 0;
+
+    if(enabled)
+        installCullVisitorEx();
+
+    applyCullVisitorSettings();
+}
+
+PickingService* OSGRenderer::pickingService()
+{
+    if(!_pickingService)
+    {
+        _pickingService = new PickingService(this);
+        _pickingScene = 0;
+    }
+
+    return _pickingService;
+}
+
+void OSGRenderer::setHoverPicking(bool enabled)
+{
+    _hoverPicking = enabled;
+
+    if(_hoverPicking)
+        pickingService();
+}
+
+void OSGRenderer::setIdBufferPicking(bool enabled)
+{
+    if(enabled == idBufferPicking())
+        return;
+
+    if(enabled)
+    {
+        _idBufferPicker = new IdBufferPicker();
+        installCullVisitorEx();
+    }
+    else
+    {
+        // its buffers and fences are deleted by the next frame, when the context is current
+        _camera->removeChild(_idBufferPicker->getCamera());
+        _retiredIdBufferPicker = _idBufferPicker;
+        _idBufferPicker = 0;
+    }
+
+    applyCullVisitorSettings();
+}
+
+void OSGRenderer::setProgramBinaryCacheDirectory(const QString& directory)
+{
+    if(directory.isEmpty())
+    {
+        _programBinaryCache = 0;
+        return;
+    }
+
+    _programBinaryCache = new ProgramBinaryCache();
+    _programBinaryCache->setDirectory(directory.toLocal8Bit().toStdString());
+    _programScene = 0;
+
+    // without the merged subgraphs the whole scene is looked at after each merge
+    _programPagerMerges = installDatabasePagerEx();
+}
+
+QString OSGRenderer::programBinaryCacheDirectory() const
+{
+    return _programBinaryCache.valid() ?
+           QString::fromLocal8Bit(_programBinaryCache->getDirectory().c_str()) : QString();
+}
+
+void OSGRenderer::markStartup(StartupStage stage, osg::Timer_t tick)
+{
+    if(stage < NumStartupStages)
+        _startupTicks[stage] = tick;
+}
+
+double OSGRenderer::startupTime(StartupStage stage) const
+{
+    if(stage >= NumStartupStages || !_startupTicks[stage])
+        return -1.0;
+
+    osg::Timer_t startTick = _startupTicks[WidgetConstructed] ?
+                             _startupTicks[WidgetConstructed] : osg::Timer::instance()->getStartTick();
+    return osg::Timer::instance()->delta_s(startTick, _startupTicks[stage]);
+}
+
+void OSGRenderer::recordReadLockWait(double seconds)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_lockStatsMutex);
+    ++_lockStats.readLocks;
+    _lockStats.readWaitTime += seconds;
+    _lockStats.maxReadWait = std::max(_lockStats.maxReadWait, seconds);
+}
+
+void OSGRenderer::recordWriteLockWait(double seconds)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_lockStatsMutex);
+    ++_lockStats.writeLocks;
+    _lockStats.writeWaitTime += seconds;
+    _lockStats.maxWriteWait = std::max(_lockStats.maxWriteWait, seconds);
+}
+
+OSGRenderer::LockStats OSGRenderer::lockStats() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_lockStatsMutex);
+    return _lockStats;
+}
+
+void OSGRenderer::resetLockStats()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_lockStatsMutex);
+    _lockStats = LockStats();
+}
+
+void OSGRenderer::setTextureBudget(unsigned long long bytes)
+{
+    if(bytes == 0)
+    {
+        _textureResidencyManager = 0;
+    }
+    else
+    {
+        if(!_textureResidencyManager)
+        {
+            _textureResidencyManager = new TextureResidencyManager();
+            installCullVisitorEx();
+        }
+
+        _textureResidencyManager->setBudget(bytes);
+    }
+
+    applyCullVisitorSettings();
+}
+
+void OSGRenderer::setMultisampling(int samples)
+{
+    _multisampling = std::max(samples, 0);
+
+    if(_multisampling > 0)
+    {
+        if(!_multisampleTarget)
+        {
+            _multisampleTarget = new MultisampleTarget();
+            installCullVisitorEx();
+        }
+
+        _multisampleTarget->setSamples(_multisampling);
+    }
+
+    if(!_frameGpuTimer)
+    {
+        _frameGpuTimer = new GpuTimer();
+        _resolveGpuTimer = new GpuTimer();
+    }
+
+    applyCullVisitorSettings();
+    update();
+}
+
+void OSGRenderer::setFxaa(bool enabled)
+{
+    _fxaa = enabled;
+
+    if(_fxaa && !_fxaaPass)
+    {
+        _fxaaPass = new FxaaPass();
+        installCullVisitorEx();
+    }
+
+    if(!_frameGpuTimer)
+    {
+        _frameGpuTimer = new GpuTimer();
+        _resolveGpuTimer = new GpuTimer();
+    }
+
+    applyCullVisitorSettings();
+    update();
+}
+
+void OSGRenderer::setProgressiveRefinement(bool enabled)
+{
+    _progressive = enabled;
+
+    if(_progressive && !_progressiveRefiner)
+    {
+        _progressiveRefiner = new ProgressiveRefiner();
+        installCullVisitorEx();
+    }
+
+    if(_progressiveRefiner.valid())
+        _progressiveRefiner->restart();
+
+    applyCullVisitorSettings();
+    update();
+}
+
+void OSGRenderer::captureDetail()
+{
+    if(_interacting || _frameBudgetGovernor.valid())
+        return;
+
+    _baseLODScale = _camera->getLODScale();
+    _baseSmallFeatureCullingPixelSize = _camera->getSmallFeatureCullingPixelSize();
+}
+
+void OSGRenderer::applyDetail()
+{
+    float lodScale = _baseLODScale;
+    float smallFeatureCullingPixelSize = _baseSmallFeatureCullingPixelSize;
+
+    if(_frameBudgetGovernor.valid())
+    {
+        lodScale = _frameBudgetGovernor->getLODScale();
+        smallFeatureCullingPixelSize = _frameBudgetGovernor->getSmallFeatureCullingPixelSize();
+    }
+
+    if(_interacting)
+    {
+        lodScale *= _progressiveRefiner->getInteractiveLODScale();
+        smallFeatureCullingPixelSize = std::max(smallFeatureCullingPixelSize,
+                                                _progressiveRefiner->getInteractiveSmallFeatureCullingPixelSize());
+    }
+
+    _camera->setLODScale(lodScale);
+    _camera->setSmallFeatureCullingPixelSize(smallFeatureCullingPixelSize);
+}
+
+void OSGRenderer::setInteracting(bool interacting)
+{
+    captureDetail();
+    _interacting = interacting;
+    applyDetail();
+
+    if(!_interacting)
+        _progressiveRefiner->restart();
+
+    applyCullVisitorSettings();
+    emit interactionChanged(_interacting);
+}
+
+void OSGRenderer::setPartialUpdate(bool enabled)
+{
+    _partialUpdate = enabled;
+    _fullRedraw = true;
+    _dirtyRegion = QRect();
+    _dirtyNodes.clear();
+}
+
+void OSGRenderer::addDirtyRegion(int x, int y, int width, int height)
+{
+    _dirtyRegion |= QRect(x, y, width, height);
+    requestRedraw();
+}
+
+void OSGRenderer::addDirtyRegion(osg::Node* node)
+{
+    if(!node)
+        return;
+
+    _dirtyNodes.push_back(node);
+    requestRedraw();
+}
+
+QRect OSGRenderer::computeDirtyRegion(osg::Node* node) const
+{
+    const osg::Viewport* viewport = _camera->getViewport();
+    QRect full(viewport->x(), viewport->y(), viewport->width(), viewport->height());
+    osg::BoundingSphere bound = node->getBound();
+
+    if(!bound.valid())
+        return QRect();
+
+    // the bound is in the coordinates of the node's parents
+    osg::MatrixList worldMatrices = node->getWorldMatrices();
+    osg::Matrixd world = worldMatrices.empty() ? osg::Matrixd() : worldMatrices.front();
+    osg::Matrixd mvp = world * _camera->getViewMatrix() * _camera->getProjectionMatrix();
+    double x0 = 1.0, y0 = 1.0, x1 = -1.0, y1 = -1.0;
+
+    for(unsigned int i = 0; i < 8; ++i)
+    {
+        osg::Vec4d corner(bound.center().x() + (i & 1 ? bound.radius() : -bound.radius()),
+                          bound.center().y() + (i & 2 ? bound.radius() : -bound.radius()),
+                          bound.center().z() + (i & 4 ? bound.radius() : -bound.radius()),
+                          1.0);
+        osg::Vec4d clip = corner * mvp;
+
+        // the bound reaches behind the eye
+        if(clip.w() <= 0.0)
+            return full;
+
+        x0 = std::min(x0, clip.x() / clip.w());
+        y0 = std::min(y0, clip.y() / clip.w());
+        x1 = std::max(x1, clip.x() / clip.w());
+        y1 = std::max(y1, clip.y() / clip.w());
+    }
+
+    // one pixel more for the rasterization of the edges
+    int left = static_cast<int>(std::floor(viewport->x() + (x0 + 1.0) * 0.5 * viewport->width())) - 1;
+    int bottom = static_cast<int>(std::floor(viewport->y() + (y0 + 1.0) * 0.5 * viewport->height())) - 1;
+    int right = static_cast<int>(std::ceil(viewport->x() + (x1 + 1.0) * 0.5 * viewport->width())) + 1;
+    int top = static_cast<int>(std::ceil(viewport->y() + (y1 + 1.0) * 0.5 * viewport->height())) + 1;
+
+    return QRect(left, bottom, right - left, top - bottom).intersected(full);
+}
+
+void OSGRenderer::applyPartialUpdate()
+{
+    osg::Viewport* viewport = _camera->getViewport();
+
+    bool full = _fullRedraw
+                || !viewport
+                || !_partialViewport.valid()
+                || _partialViewport->compare(*viewport) != 0
+                || _partialView != _camera->getViewMatrix()
+                || _partialProjection != _camera->getProjectionMatrix()
+                || _partialScene != getSceneData();
+
+    QRect region = _dirtyRegion;
+
+    for(unsigned int i = 0; !full && i < _dirtyNodes.size(); ++i)
+    {
+        osg::ref_ptr<osg::Node> node;
+
+        if(_dirtyNodes[i].lock(node))
+            region |= computeDirtyRegion(node.get());
+    }
+
+    _fullRedraw = false;
+    _dirtyRegion = QRect();
+    _dirtyNodes.clear();
+
+    if(!full)
+        region = region.intersected(QRect(viewport->x(), viewport->y(), viewport->width(), viewport->height()));
+
+    if(full || region.isEmpty())
+    {
+        if(viewport)
+        {
+            _partialViewport = new osg::Viewport(*viewport);
+            _partialRegion = QRect(viewport->x(), viewport->y(), viewport->width(), viewport->height());
+        }
+
+        _partialView = _camera->getViewMatrix();
+        _partialProjection = _camera->getProjectionMatrix();
+        _partialScene = getSceneData();
+        return;
+    }
+
+    // the region of the viewport mapped to the whole clip space
+    double sx = viewport->width() / region.width();
+    double sy = viewport->height() / region.height();
+    double cx = (region.x() + 0.5 * region.width() - viewport->x()) / viewport->width() * 2.0 - 1.0;
+    double cy = (region.y() + 0.5 * region.height() - viewport->y()) / viewport->height() * 2.0 - 1.0;
+
+    _camera->setProjectionMatrix(_partialProjection *
+                                 osg::Matrixd::translate(-cx, -cy, 0.0) *
+                                 osg::Matrixd::scale(sx, sy, 1.0));
+    // the render stage clears the viewport only
+    viewport->setViewport(region.x(), region.y(), region.width(), region.height());
+    _partialRegion = region;
+    _partialFrame = true;
+}
+
+void OSGRenderer::setInputLatencyMonitoring(bool enabled)
+{
+    _inputLatencyMonitor = enabled ? new InputLatencyMonitor() : 0;
+}
+
+void OSGRenderer::framePresented()
+{
+    if(_inputLatencyMonitor.valid())
+        _inputLatencyMonitor->present();
+}
+
+QPoint OSGRenderer::mapFromGlobal(const QPoint& position) const
+{
+    switch(_windowType)
+    {
+    case enQGLView:
+        return static_cast<osgQOpenGLView*>(parent())->viewport()->mapFromGlobal(position);
+
+    case enQGLWindow:
+        return static_cast<osgQOpenGLWindow*>(parent())->mapFromGlobal(position);
+
+    case enQGLWidget:
+        return static_cast<osgQOpenGLWidget*>(parent())->mapFromGlobal(position);
+
+    default:
+        return position;
+    }
+}
+
+OpenThreads::ReadWriteMutex* OSGRenderer::widgetMutex() const
+{
+    switch(_windowType)
+    {
+    case enQGLView:
+        return static_cast<osgQOpenGLView*>(parent())->mutex();
+
+    case enQGLWindow:
+        return static_cast<osgQOpenGLWindow*>(parent())->mutex();
+
+    case enQGLWidget:
+        return static_cast<osgQOpenGLWidget*>(parent())->mutex();
+
+    default:
+        return nullptr;
+    }
+}
+
+ModelLoadHandle* OSGRenderer::loadAsync(const QString& path, osg::Group* parent)
+{
+    return modelLoader()->load(path, parent);
+}
+
+ModelLoader* OSGRenderer::modelLoader()
+{
+    if(!_modelLoader)
+    {
+        _modelLoader = new ModelLoader(widgetMutex(), this);
+        _modelLoader->setRenderer(this);
+    }
+
+    return _modelLoader;
+}
+
+void OSGRenderer::lateLatchCamera()
+{
+    _lateLatchDistance = 0.0;
+
+    osgGA::EventQueue* eventQueue = m_osgWinEmb->getEventQueue();
+    osgGA::GUIEventAdapter* current = eventQueue->getCurrentEventState();
+
+    if(!_cameraManipulator.valid() || current->getButtonMask() == 0)
+        return;
+
+    QPoint position = mapFromGlobal(QCursor::pos());
+    float x = position.x() * m_windowScale;
+    float y = position.y() * m_windowScale;
+
+    if(x == current->getX() && y == current->getY())
+        return;
+
+    _lateLatchDistance = std::sqrt((x - current->getX()) * (x - current->getX()) +
+                                   (y - current->getY()) * (y - current->getY()));
+
+    OSGQOPENGL_TRACE_ZONE("late latch");
+    current->setX(x);
+    current->setY(y);
+
+    // the manipulator only, the event handlers see the position with Qt's next event
+    osg::ref_ptr<osgGA::GUIEventAdapter> event = eventQueue->createEvent();
+    event->setEventType(osgGA::GUIEventAdapter::DRAG);
+    event->setTime(eventQueue->getTime());
+    _cameraManipulator->handle(*event, *this);
+
+    _camera->setViewMatrix(_cameraManipulator->getInverseMatrix());
+    updateSlaves();
+}
+
+void OSGRenderer::collectAntialiasingTimes()
+{
+    int tag = 0;
+    double seconds = 0.0;
+
+    while(_frameGpuTimer->takeResult(tag, seconds))
+    {
+        unsigned int& frames = _antialiasingCost.frames[tag];
+        double& time = _antialiasingCost.frameGpuTime[tag];
+        time += (seconds - time) / ++frames;
+    }
+
+    while(_resolveGpuTimer->takeResult(tag, seconds))
+    {
+        unsigned int& passes = _antialiasingCost.passes[MultisampleAntialiasing];
+        double& time = _antialiasingCost.passGpuTime[MultisampleAntialiasing];
+        time += (seconds - time) / ++passes;
+    }
+
+    while(_fxaaPass.valid() && _fxaaPass->getGpuTimer()->takeResult(tag, seconds))
+    {
+        unsigned int& passes = _antialiasingCost.passes[FxaaAntialiasing];
+        double& time = _antialiasingCost.passGpuTime[FxaaAntialiasing];
+        time += (seconds - time) / ++passes;
+    }
+}
+
+void OSGRenderer::collectFrameStats()
+{
+    osg::Stats* stats = _camera->getStats();
+    unsigned int frameNumber = getFrameStamp()->getFrameNumber();
+
+    // each feature's counters next to the cull and draw times, under its own stats name
+    if(stats)
+    {
+        if(_textureResidencyManager.valid() && stats->collectStats("residency"))
+            _textureResidencyManager->reportStats(*stats, frameNumber);
+
+        if(_occlusionCulling && stats->collectStats("occlusion"))
+            _occlusionBuffer->reportStats(*stats, frameNumber);
+
+        if(_multisampleTarget.valid() && stats->collectStats("multisample"))
+            _multisampleTarget->reportStats(*stats, frameNumber);
+
+        if(_frameGpuTimer.valid() && stats->collectStats("antialiasing"))
+        {
+            GpuTimer* passTimer = antialiasing() == FxaaAntialiasing ? _fxaaPass->getGpuTimer() : _resolveGpuTimer.get();
+            stats->setAttribute(frameNumber, "Antialiasing mode", antialiasing());
+            stats->setAttribute(frameNumber, "Antialiasing frame GPU time", _frameGpuTimer->getAverageTime());
+            stats->setAttribute(frameNumber, "Antialiasing pass GPU time",
+                                antialiasing() != NoAntialiasing ? passTimer->getAverageTime() : 0.0);
+        }
+
+        if(_lateLatch && stats->collectStats("latency"))
+            stats->setAttribute(frameNumber, "Late latch distance", _lateLatchDistance);
+
+        if(_inputLatencyMonitor.valid() && stats->collectStats("latency"))
+            _inputLatencyMonitor->reportStats(*stats, frameNumber);
+
+        if(_partialUpdate && stats->collectStats("partial"))
+        {
+            stats->setAttribute(frameNumber, "Partial update drawn pixels",
+                                static_cast<double>(_partialRegion.width()) * _partialRegion.height());
+            stats->setAttribute(frameNumber, "Partial update viewport pixels",
+                                _partialViewport.valid() ? _partialViewport->width() * _partialViewport->height() : 0.0);
+        }
+
+        if(_progressive && stats->collectStats("refinement"))
+            _progressiveRefiner->reportStats(*stats, frameNumber);
+
+        if(_radixSortCallback.valid() && stats->collectStats("sort"))
+            _radixSortCallback->reportStats(*stats, frameNumber);
+
+        if(_instanceBatcher.valid() && stats->collectStats("instancing"))
+            _instanceBatcher->reportStats(*stats, frameNumber);
+    }
+
+    // the counters are per frame
+    if(_textureResidencyManager.valid())
+        _textureResidencyManager->resetStats();
+
+    if(_occlusionCulling)
+        _occlusionBuffer->resetStats();
+
+    if(_multisampleTarget.valid())
+        _multisampleTarget->resetStats();
+
+    if(_radixSortCallback.valid())
+        _radixSortCallback->resetStats();
+
+    if(_instanceBatcher.valid())
+        _instanceBatcher->resetStats();
+}
+
+void OSGRenderer::setGpuMemoryAccounting(bool enabled)
+{
+    if(enabled == gpuMemoryAccounting())
+        return;
+
+    if(enabled)
+    {
+        _gpuMemoryMonitor = new GpuMemoryMonitor();
+        _gpuMemoryMonitor->setBudgetCallback(new GpuMemoryBudgetCallback(this));
+    }
+    else
+    {
+        _gpuMemoryMonitor = 0;
+    }
+}
+
+InputRecorder* OSGRenderer::inputRecorder()
+{
+    if(!_inputRecorder)
+        _inputRecorder = new InputRecorder();
+
+    return _inputRecorder.get();
+}
+
+bool OSGRenderer::startInputRecording(const QString& fileName)
+{
+    if(!inputRecorder()->startRecording(fileName.toLocal8Bit().toStdString()))
+        return false;
+
+    // start from the current window size so that the replay does too
+    if(m_osgInitialized)
+        recordInput(InputRecorder::RESIZE, _viewportWidth, _viewportHeight);
+
+    return true;
+}
+
+void OSGRenderer::stopInputRecording()
+{
+    if(_inputRecorder.valid())
+        _inputRecorder->stopRecording();
+}
+
+bool OSGRenderer::startInputReplay(const QString& fileName, InputRecorder::Timing timing)
+{
+    if(!inputRecorder()->startReplay(fileName.toLocal8Bit().toStdString(), timing))
+        return false;
+
+    requestRedraw();
+    update();
+    return true;
+}
+
+void OSGRenderer::stopInputReplay()
+{
+    if(_inputRecorder.valid())
+        _inputRecorder->stopReplay();
+}
+
+void OSGRenderer::setTargetFrameRate(double frameRate)
+{
+    if(frameRate <= 0.0)
+    {
+        if(_frameBudgetGovernor.valid())
+        {
+            _frameBudgetGovernor->reset();
+            applyFrameBudget();
+            _frameBudgetGovernor = 0;
+            applyDetail();
+        }
+
+        return;
+    }
+
+    if(!_frameBudgetGovernor)
+    {
+        captureDetail();
+
+        _frameBudgetGovernor = new FrameBudgetGovernor();
+        _frameBudgetGovernor->setLODScaleRange(_baseLODScale, _baseLODScale * 4.0f);
+        _frameBudgetGovernor->setSmallFeatureCullingPixelSizeRange(
+            _baseSmallFeatureCullingPixelSize, _baseSmallFeatureCullingPixelSize * 16.0f);
+    }
+
+    _frameBudgetGovernor->setTargetFrameRate(frameRate);
+}
+
+void OSGRenderer::applyFrameBudget()
+{
+    applyDetail();
+
+    emit qualityChanged(_frameBudgetGovernor->getLevel(), _frameBudgetGovernor->getQuality(),
+                        _frameBudgetGovernor->getAverageFrameTime());
+}
+
+void OSGRenderer::installCullVisitorEx()
+{
+    if(_cullVisitorExInstalled)
+        return;
+
+    osgViewer::Renderer* renderer = dynamic_cast<osgViewer::Renderer*>(_camera->getRenderer());
+
+    if(!renderer)
+        return;
+
+    for(unsigned int i = 0; i < 2; ++i)
+    {
+        osgUtil::SceneView* sceneView = renderer->getSceneView(i);
+
+        if(!sceneView)
+            continue;
+
+        if(!dynamic_cast<CullVisitorEx*>(sceneView->getCullVisitor()))
+            sceneView->setCullVisitor(new CullVisitorEx());
+
+        osgUtil::RenderStage* stage = sceneView->getRenderStage();
+
+        if(stage && !dynamic_cast<RenderStageEx*>(stage))
+        {
+            osg::ref_ptr<RenderStageEx> stageEx = new RenderStageEx();
+            stageEx->setCamera(stage->getCamera());
+            stageEx->setDrawBuffer(stage->getDrawBuffer(), stage->getDrawBufferApplyMask());
+            stageEx->setReadBuffer(stage->getReadBuffer(), stage->getReadBufferApplyMask());
+            sceneView->setRenderStage(stageEx.get());
+        }
+    }
+
+    _cullVisitorExInstalled = true;
+}
+
+std::vector<CullVisitorEx*> OSGRenderer::cullVisitorsEx() const
+{
+    std::vector<CullVisitorEx*> visitors;
+    osgViewer::Renderer* renderer = dynamic_cast<osgViewer::Renderer*>(_camera->getRenderer());
+
+    if(!renderer)
+        return visitors;
+
+    for(unsigned int i = 0; i < 2; ++i)
+    {
+        osgUtil::SceneView* sceneView = renderer->getSceneView(i);
+        CullVisitorEx* cv = sceneView ? dynamic_cast<CullVisitorEx*>(sceneView->getCullVisitor()) : 0;
+
+        if(cv)
+            visitors.push_back(cv);
+    }
+
+    return visitors;
+}
+
+void OSGRenderer::applyCullVisitorSettings()
+{
+    std::vector<CullVisitorEx*> visitors = cullVisitorsEx();
+
+    for(std::vector<CullVisitorEx*>::iterator itr = visitors.begin(); itr != visitors.end(); ++itr)
+    {
+        (*itr)->setSceneModifiedCount(_sceneModifiedCount);
+        (*itr)->setOcclusionBuffer(_occlusionCulling ? _occlusionBuffer.get() : 0);
+        (*itr)->setIdBufferPicker(_idBufferPicker.get());
+    }
+
+    osgViewer::Renderer* renderer = dynamic_cast<osgViewer::Renderer*>(_camera->getRenderer());
+
+    for(unsigned int i = 0; renderer && i < 2; ++i)
+    {
+        osgUtil::SceneView* sceneView = renderer->getSceneView(i);
+        RenderStageEx* stage = sceneView ? dynamic_cast<RenderStageEx*>(sceneView->getRenderStage()) : 0;
+
+        if(stage)
+        {
+            stage->setRadixSortCallback(_radixSortCallback.get());
+            stage->setInstanceBatcher(_instanceBatcher.get());
+            stage->setTextureResidencyManager(_textureResidencyManager.get());
+            stage->setMultisampleTarget(antialiasing() == MultisampleAntialiasing ? _multisampleTarget.get() : 0);
+
+            // the main camera draws into the window's framebuffer unless filtered or accumulated
+            if(_progressive && !_interacting)
+            {
+                stage->setFrameBufferObject(_progressiveRefiner->getFrameBufferObject());
+                stage->setDrawCallback(_progressiveRefiner.get());
+            }
+            else if(antialiasing() == FxaaAntialiasing)
+            {
+                stage->setFrameBufferObject(_fxaaPass->getFrameBufferObject());
+                stage->setDrawCallback(_fxaaPass.get());
+            }
+            else if(_fxaaPass.valid() || _progressiveRefiner.valid())
+            {
+                stage->setFrameBufferObject(0);
+                stage->setDrawCallback(0);
+            }
+        }
+    }
+}
+
+void OSGRenderer::resize(int windowWidth, int windowHeight, float windowScale)
+{
+    if(!m_osgInitialized)
+        return;
+
+    m_windowScale = windowScale;
+    _windowWidth = windowWidth * windowScale;
+    _windowHeight = windowHeight * windowScale;
+    ++_resizeStats.resizeEvents;
+
+    if(_resizeMode == DebouncedResize)
+    {
+        if(_resizeTimerId)
+            killTimer(_resizeTimerId);
+
+        if(_releaseTimerId)
+        {
+            killTimer(_releaseTimerId);
+            _releaseTimerId = 0;
+        }
+
+        // the target is drawn to again, a pending release would pull it from under
+        // frameOffscreen()
+        _releaseTargetRequested = false;
+
+        // frames go through the offscreen target until the timer fires
+        _resizeTimerId = startTimer(_resizeDebounceInterval);
+
+        // present the frame of the first event until the resize events stop
+        if(_offscreenFrameValid)
+        {
+            update();
+            return;
+        }
+    }
+
+    applyResize();
+}
+
+void OSGRenderer::applyResize()
+{
+    ++_resizeStats.appliedResizes;
+    _viewportWidth = _windowWidth;
+    _viewportHeight = _windowHeight;
+
+    m_osgWinEmb->getEventQueue()->windowResize(0, 0, _viewportWidth, _viewportHeight);
+    m_osgWinEmb->resized(0, 0, _viewportWidth, _viewportHeight);
+    recordInput(InputRecorder::RESIZE, _viewportWidth, _viewportHeight);
+
+    // the frames drawn while resizing are interactive ones
+    if(_progressive)
+        _progressiveRefiner->notifyInput();
+
+    update();
+}
+
+void OSGRenderer::setResizeMode(ResizeMode mode)
+{
+    if(_resizeMode == mode)
+        return;
+
+    _resizeMode = mode;
+
+    if(_resizeTimerId)
+    {
+        killTimer(_resizeTimerId);
+        _resizeTimerId = 0;
+    }
+
+    if(_releaseTimerId)
+    {
+        killTimer(_releaseTimerId);
+        _releaseTimerId = 0;
+    }
+
+    // the target is released by the next frame, when the context is current
+    _offscreenFrameValid = false;
+    _releaseTargetRequested = true;
+
+    if(m_osgInitialized && (_viewportWidth != _windowWidth || _viewportHeight != _windowHeight))
+        applyResize();
+    else
+        update();
+}
+
+void OSGRenderer::setDefaultFramebuffer(GLuint framebuffer)
+{
+    if(framebuffer != _defaultFramebuffer)
+    {
+        ++_resizeStats.framebufferChanges;
+        _defaultFramebuffer = framebuffer;
+    }
+
+    // QOpenGLWidget gets a new framebuffer when resized
+    if(m_osgWinEmb.valid() && !_renderingOffscreen)
+        m_osgWinEmb->setDefaultFboId(_defaultFramebuffer);
+}
+
+void OSGRenderer::frameOffscreen(double simulationTime)
+{
+    QOpenGLContext* context = QOpenGLContext::currentContext();
+
+    _renderingOffscreen = true;
+
+    if(!context || !m_osgInitialized)
+    {
+        frame(simulationTime);
+        _renderingOffscreen = false;
+        return;
+    }
+
+    if(!_offscreenFrameValid)
+    {
+        updateOffscreenTarget();
+
+        m_osgWinEmb->setDefaultFboId(_offscreenTarget->handle());
+        frame(simulationTime);
+        m_osgWinEmb->setDefaultFboId(_defaultFramebuffer);
+
+        _offscreenFrameValid = true;
+    }
+    else
+    {
+        ++_resizeStats.presentOnlyFrames;
+    }
+
+    _renderingOffscreen = false;
 
-OSGRenderer::~OSGRenderer()
-{
-}
+    // copy the rendered part of the target, stretched to the window during a resize
+    QOpenGLExtraFunctions* f = context->extraFunctions();
+    GLboolean scissorTest = f->glIsEnabled(GL_SCISSOR_TEST);
 
-void OSGRenderer::update()
-{
-	switch (_windowType)
-	{
-	case enQGLView:
-	{
-		auto view = (osgQOpenGLView*)parent();
-        view->_osgWantsToRenderFrame = true;
-		view->scene()->update();
-		break;
-	}
-	case enQGLWindow:
-	{
-		auto window = (osgQOpenGLWindow*)parent();
-        window->_osgWantsToRenderFrame = true;
-		window->update();
-		break;
-	}
-	case enQGLWidget:
-	{
-		auto* widget = (osgQOpenGLWidget*)(parent());
-        widget->_osgWantsToRenderFrame = true;
-        widget->update();
-		break;
-	}
-	default:
-		break;
-	}    
+    if(scissorTest)
+        f->glDisable(GL_SCISSOR_TEST);
+
+    bool stretch = _viewportWidth != _windowWidth || _viewportHeight != _windowHeight;
+    f->glBindFramebuffer(GL_READ_FRAMEBUFFER, _offscreenTarget->handle());
+    f->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _defaultFramebuffer);
+    f->glBlitFramebuffer(0, 0, _viewportWidth, _viewportHeight, 0, 0, _windowWidth, _windowHeight,
+                         GL_COLOR_BUFFER_BIT, stretch ? GL_LINEAR : GL_NEAREST);
+    f->glBindFramebuffer(GL_FRAMEBUFFER, _defaultFramebuffer);
+
+    if(scissorTest)
+        f->glEnable(GL_SCISSOR_TEST);
 }
 
-void OSGRenderer::resize(int windowWidth, int windowHeight, float windowScale)
+void OSGRenderer::updateOffscreenTarget()
 {
-    if(!m_osgInitialized)
-        return;
+    int step = _resizeTargetStep;
+    int width = (std::max(_viewportWidth, 1) + step - 1) / step * step;
+    int height = (std::max(_viewportHeight, 1) + step - 1) / step * step;
 
-    m_windowScale = windowScale;
-    m_osgWinEmb->getEventQueue()->windowResize(0, 0, windowWidth * windowScale, windowHeight * windowScale);
-    m_osgWinEmb->resized(0, 0, windowWidth * windowScale, windowHeight * windowScale);
-    //_camera->setViewport(0, 0, windowWidth * windowScale, windowHeight * windowScale);
-    update();
+    if(_offscreenTarget)
+    {
+        if(_offscreenTarget->width() >= _viewportWidth && _offscreenTarget->height() >= _viewportHeight)
+            return;
+
+        // leave room for the window to keep growing
+        width += step;
+        height += step;
+    }
+
+    QOpenGLFramebufferObjectFormat format;
+    format.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+    _offscreenTarget.reset(new QOpenGLFramebufferObject(width, height, format));
+    ++_resizeStats.targetReallocations;
 }
 
 
@@ -192,12 +1310,28 @@ void OSGRenderer::setupOSG(int windowWidth, int windowHeight, float windowScale)
 {
     m_osgInitialized = true;
     m_windowScale = windowScale;
-    m_osgWinEmb = new osgViewer::GraphicsWindowEmbedded(0, 0, 60 * windowScale, 48 * windowScale);
+
+    if(_prewarmer && _prewarmer->graphicsContext())
+    {
+        // share the context id of the prewarmer, whose objects are then used as they are
+        osg::ref_ptr<osg::GraphicsContext::Traits> traits = new osg::GraphicsContext::Traits;
+        traits->width = 60 * windowScale;
+        traits->height = 48 * windowScale;
+        traits->sharedContext = _prewarmer->graphicsContext();
+        m_osgWinEmb = new osgViewer::GraphicsWindowEmbedded(traits.get());
+    }
+    else
+    {
+        m_osgWinEmb = new osgViewer::GraphicsWindowEmbedded(0, 0, 60 * windowScale, 48 * windowScale);
+    }
+
     //m_osgWinEmb = new osgViewer::GraphicsWindowEmbedded(0, 0, windowWidth * windowScale, windowHeight * windowScale);
     // make sure the event queue has the correct window rectangle size and input range
     m_osgWinEmb->getEventQueue()->syncWindowRectangleWithGraphicsContext();
     _camera->setGraphicsContext(m_osgWinEmb.get());
     _camera->setViewport(0, 0, 60 * windowScale, 48 * windowScale);
+    _windowWidth = _viewportWidth = 60 * windowScale;
+    _windowHeight = _viewportHeight = 48 * windowScale;
     // disable key event (default is Escape key) that the viewer checks on each
     // frame to see
     // if the viewer's done flag should be set to signal end of viewers main
@@ -211,6 +1345,8 @@ void OSGRenderer::setupOSG(int windowWidth, int windowHeight, float windowScale)
 
     _timerId = startTimer(10, Qt::PreciseTimer);
     _lastFrameStartTime.setStartTick(0);
+
+    markStartup(RendererCreated);
 }
 
 void OSGRenderer::setKeyboardModifiers(QInputEvent* event)
@@ -229,15 +1365,41 @@ void OSGRenderer::setKeyboardModifiers(QInputEvent* event)
     m_osgWinEmb->getEventQueue()->getCurrentEventState()->setModKeyMask(mask);
 }
 
+void OSGRenderer::inputQueued()
+{
+    if(_progressive)
+        _progressiveRefiner->notifyInput();
+
+    if(_inputLatencyMonitor.valid())
+        _inputLatencyMonitor->addInput();
+}
+
+void OSGRenderer::recordInput(InputRecorder::EventType type, float x, float y, int a, int b)
+{
+    if(_inputRecorder.valid() && _inputRecorder->isRecording())
+    {
+        _inputRecorder->record(type, m_osgWinEmb->getEventQueue()->getCurrentEventState()->getModKeyMask(),
+                               x, y, a, b);
+    }
+}
+
 void OSGRenderer::keyPressEvent(QKeyEvent* event)
 {
+    if(inputReplaying())
+        return;
+
     setKeyboardModifiers(event);
     int value = s_QtKeyboardMap.remapKey(event);
     m_osgWinEmb->getEventQueue()->keyPress(value);
+    inputQueued();
+    recordInput(InputRecorder::KEY_PRESS, 0.0f, 0.0f, value);
 }
 
 void OSGRenderer::keyReleaseEvent(QKeyEvent* event)
 {
+    if(inputReplaying())
+        return;
+
     if(event->isAutoRepeat())
     {
         event->ignore();
@@ -247,11 +1409,16 @@ void OSGRenderer::keyReleaseEvent(QKeyEvent* event)
         setKeyboardModifiers(event);
         int value = s_QtKeyboardMap.remapKey(event);
         m_osgWinEmb->getEventQueue()->keyRelease(value);
+        inputQueued();
+        recordInput(InputRecorder::KEY_RELEASE, 0.0f, 0.0f, value);
     }
 }
 
 void OSGRenderer::mousePressEvent(QMouseEvent* event)
 {
+    if(inputReplaying())
+        return;
+
     int button = 0;
 
     switch(event->button())
@@ -280,10 +1447,15 @@ void OSGRenderer::mousePressEvent(QMouseEvent* event)
     setKeyboardModifiers(event);
     m_osgWinEmb->getEventQueue()->mouseButtonPress(event->x() * m_windowScale,
                                                    event->y() * m_windowScale, button);
+    inputQueued();
+    recordInput(InputRecorder::MOUSE_PRESS, event->x() * m_windowScale, event->y() * m_windowScale, button);
 }
 
 void OSGRenderer::mouseReleaseEvent(QMouseEvent* event)
 {
+    if(inputReplaying())
+        return;
+
     int button = 0;
 
     switch(event->button())
@@ -312,10 +1484,15 @@ void OSGRenderer::mouseReleaseEvent(QMouseEvent* event)
     setKeyboardModifiers(event);
     m_osgWinEmb->getEventQueue()->mouseButtonRelease(event->x() * m_windowScale,
                                                      event->y() * m_windowScale, button);
+    inputQueued();
+    recordInput(InputRecorder::MOUSE_RELEASE, event->x() * m_windowScale, event->y() * m_windowScale, button);
 }
 
 void OSGRenderer::mouseDoubleClickEvent(QMouseEvent* event)
 {
+    if(inputReplaying())
+        return;
+
     int button = 0;
 
     switch(event->button())
@@ -344,26 +1521,53 @@ void OSGRenderer::mouseDoubleClickEvent(QMouseEvent* event)
     setKeyboardModifiers(event);
     m_osgWinEmb->getEventQueue()->mouseDoubleButtonPress(event->x() * m_windowScale,
                                                          event->y() * m_windowScale, button);
+    inputQueued();
+    recordInput(InputRecorder::MOUSE_DOUBLE_CLICK, event->x() * m_windowScale, event->y() * m_windowScale, button);
 }
 
 void OSGRenderer::mouseMoveEvent(QMouseEvent* event)
 {
+    if(inputReplaying())
+        return;
+
     setKeyboardModifiers(event);
     m_osgWinEmb->getEventQueue()->mouseMotion(event->x() * m_windowScale,
                                               event->y() * m_windowScale);
+    inputQueued();
+    recordInput(InputRecorder::MOUSE_MOTION, event->x() * m_windowScale, event->y() * m_windowScale);
+
+    if(_hoverPicking && _camera->getViewport())
+    {
+        _pickingService->pick(_camera.get(), event->x() * m_windowScale,
+                              _camera->getViewport()->height() - event->y() * m_windowScale);
+    }
+
+    if(_idBufferPicker.valid() && _camera->getViewport())
+    {
+        _idBufferPicker->pick(event->x() * m_windowScale,
+                              _camera->getViewport()->height() - event->y() * m_windowScale);
+        requestRedraw();
+    }
 }
 
 void OSGRenderer::wheelEvent(QWheelEvent* event)
 {
-    setKeyboardModifiers(event);
-    m_osgWinEmb->getEventQueue()->mouseMotion(event->x() * m_windowScale,
-                                              event->y() * m_windowScale);
-    m_osgWinEmb->getEventQueue()->mouseScroll(
+    if(inputReplaying())
+        return;
+
+    osgGA::GUIEventAdapter::ScrollingMotion motion =
         event->orientation() == Qt::Vertical ?
         (event->delta() > 0 ? osgGA::GUIEventAdapter::SCROLL_UP :
          osgGA::GUIEventAdapter::SCROLL_DOWN) :
         (event->delta() > 0 ? osgGA::GUIEventAdapter::SCROLL_LEFT :
-         osgGA::GUIEventAdapter::SCROLL_RIGHT));
+         osgGA::GUIEventAdapter::SCROLL_RIGHT);
+
+    setKeyboardModifiers(event);
+    m_osgWinEmb->getEventQueue()->mouseMotion(event->x() * m_windowScale,
+                                              event->y() * m_windowScale);
+    m_osgWinEmb->getEventQueue()->mouseScroll(motion);
+    inputQueued();
+    recordInput(InputRecorder::SCROLL, event->x() * m_windowScale, event->y() * m_windowScale, motion);
 }
 
 bool OSGRenderer::checkEvents()
@@ -407,11 +1611,29 @@ bool OSGRenderer::checkNeedToDoFrame()
     if(_requestContinousUpdate)
         return true;
 
+    // check if scene commands are waiting for the update traversal
+    if(_sceneCommandQueue->hasPending())
+        return true;
+
     // check if the view needs to update the scene graph
     // this check if camera has update callback and if scene requires to update scene graph
     if(requiresUpdateSceneGraph())
         return true;
 
+    // the slaves with scenes of their own, e.g. the cameras of osgQOpenGLViewItem, are
+    // updated by the update traversal but not looked at by requiresUpdateSceneGraph()
+    for(unsigned int i = 0; i < getNumSlaves(); ++i)
+    {
+        const osg::View::Slave& slave = getSlave(i);
+
+        if(slave._camera.valid() && !slave._useMastersSceneData
+           && (slave._camera->getUpdateCallback()
+               || slave._camera->getNumChildrenRequiringUpdateTraversal() > 0))
+        {
+            return true;
+        }
+    }
+
     // check if the database pager needs to update the scene
     if(getDatabasePager()->requiresUpdateSceneGraph())
         return true;
@@ -442,6 +1664,35 @@ bool OSGRenderer::checkNeedToDoFrame()
 // called from ViewerWidget paintGL() method
 void OSGRenderer::frame(double simulationTime)
 {
+    // the hidden context of the prewarmer uses the window's context id until it is done
+    if(_prewarmer && !_prewarmAdopted)
+    {
+        if(_prewarmer->isRunning())
+            return;
+
+        if(_prewarmer->isFinished())
+        {
+            _prewarmAdopted = true;
+
+            if(_prewarmer->sceneData() && !getSceneData())
+                setSceneData(_prewarmer->sceneData());
+        }
+    }
+
+    if(_resizeMode == DebouncedResize && _resizeTimerId && !_renderingOffscreen)
+    {
+        frameOffscreen(simulationTime);
+        return;
+    }
+
+    // the target is only drawn to while the window is being resized, and not
+    // released from the frame frameOffscreen() draws into it
+    if(_releaseTargetRequested && !_renderingOffscreen)
+    {
+        _offscreenTarget.reset();
+        _releaseTargetRequested = false;
+    }
+
     // limit the frame rate
     if(getRunMaxFrameRate() > 0.0)
     {
@@ -449,7 +1700,10 @@ void OSGRenderer::frame(double simulationTime)
         double minFrameTime = 1.0 / getRunMaxFrameRate();
 
         if(dt < minFrameTime)
+        {
+            OSGQOPENGL_TRACE_ZONE("frame rate limit");
             QThread::usleep(static_cast<unsigned int>(1000000.0 * (minFrameTime - dt)));
+        }
     }
 
     // avoid excessive CPU loading when no frame is required in ON_DEMAND mode
@@ -458,16 +1712,269 @@ void OSGRenderer::frame(double simulationTime)
         double dt = _lastFrameStartTime.time_s();
 
         if(dt < 0.01)
+        {
+            OSGQOPENGL_TRACE_ZONE("on demand sleep");
             OpenThreads::Thread::microSleep(static_cast<unsigned int>(1000000.0 *
                                                                       (0.01 - dt)));
+        }
     }
 
     // record start frame time
     _lastFrameStartTime.setStartTick();
+
+    bool pagerMerges = getDatabasePager()->requiresUpdateSceneGraph();
+
+    // the merged data may be anywhere in the view
+    if(pagerMerges)
+        _fullRedraw = true;
+
+    // the commands queued so far are run by this frame's update traversal
+    if(_sceneCommandQueue->swap() > 0)
+        dirtyScene();
+
+    // edits made outside of the update traversal since the last frame
+    unsigned int sceneEditCount = _sceneModifiedCount;
+
+    if(_progressiveRefiner.valid())
+    {
+        bool interacting = _progressive && _progressiveRefiner->isInteracting();
+
+        if(interacting != _interacting)
+            setInteracting(interacting);
+
+        if(_progressive && !_interacting)
+            _progressiveRefiner->resize(_viewportWidth, _viewportHeight);
+    }
+
+    // the picker's camera is a child of the main camera, whose cull result may be reused
+    if(_idBufferPicker.valid() && _idBufferPicker->prepareFrame(*_camera, getSceneData()))
+        dirtyScene();
+
+    if(_cullVisitorExInstalled)
+    {
+        // pending updates or paged data will modify the scene in this frame's update
+        // traversal, so the previous cull results can not be drawn again.
+        if(pagerMerges
+           || requiresUpdateSceneGraph()
+           || getImagePager()->requiresUpdateSceneGraph())
+        {
+            dirtyScene();
+        }
+
+        if(_occlusionCulling && (pagerMerges || _occluderScene != getSceneData()))
+        {
+            _occluderScene = getSceneData();
+            _occlusionBuffer->collectOccluders(getSceneData());
+        }
+
+        applyCullVisitorSettings();
+    }
+
+    if(_programBinaryCache.valid() && _camera->getGraphicsContext())
+    {
+        // the state's extensions are set up by realize(), which the first frame would
+        // only call right before compiling its programs
+        if(_firstFrame)
+        {
+            viewerInit();
+
+            if(!isRealized())
+                realize();
+
+            _firstFrame = false;
+        }
+
+        // paged data is merged by the update traversal, its subgraphs are handed to the
+        // cache by the pager and looked at next frame. The whole scene is only visited
+        // when it is replaced or edited outside of the update traversal.
+        bool rescan = (_programRescan && !_programPagerMerges)
+                      || _programScene != getSceneData()
+                      || _programSceneModifiedCount != sceneEditCount;
+        _programRescan = pagerMerges;
+        _programScene = getSceneData();
+        _programSceneModifiedCount = _sceneModifiedCount;
+
+        _programBinaryCache->update(*_camera->getGraphicsContext()->getState(), getSceneData(), rescan);
+    }
+
     // make frame
 
+    // the replayed events take the place of the ones received since the last frame
+    bool replaying = inputReplaying();
+
+    if(replaying && !_inputRecorder->replayFrame(m_osgWinEmb.get(), simulationTime))
+    {
+        replaying = false;
+        emit inputReplayFinished();
+    }
+
 #if 1
+    osg::Timer_t frameStartTick = osg::Timer::instance()->tick();
+    bool firstSceneFrame = !_startupTicks[FirstFrame] && getSceneData();
+
+    if(firstSceneFrame)
+    {
+        markStartup(SceneReady, frameStartTick);
+        markStartup(FirstFrameStart, frameStartTick);
+    }
+
+    // the frame is drawn into the multisampled target, then resolved into the
+    // framebuffer it was meant for, the window's or the offscreen target's
+    QOpenGLContext* context = QOpenGLContext::currentContext();
+    GLuint resolveFramebuffer = m_osgInitialized ? m_osgWinEmb->getDefaultFboId() : 0;
+    bool multisample = false;
+
+    if(_multisampleTarget.valid() && context && m_osgInitialized)
+    {
+        if(_multisampling > 0)
+        {
+            multisample = antialiasing() == MultisampleAntialiasing
+                          && _multisampleTarget->begin(*context, _viewportWidth, _viewportHeight);
+        }
+        else
+        {
+            _multisampleTarget->release();
+            _multisampleTarget = 0;
+        }
+    }
+
+    if(multisample)
+        m_osgWinEmb->setDefaultFboId(_multisampleTarget->getFramebuffer());
+
+    if(antialiasing() == FxaaAntialiasing)
+        _fxaaPass->resize(_viewportWidth, _viewportHeight);
+
+    // the event traversal of this frame takes the inputs queued so far
+    if(_inputLatencyMonitor.valid())
+        _inputLatencyMonitor->beginFrame();
+
+    Antialiasing mode = antialiasing() == FxaaAntialiasing ? FxaaAntialiasing :
+                        multisample ? MultisampleAntialiasing : NoAntialiasing;
+    bool gpuTiming = _frameGpuTimer.valid() && context;
+
+    if(gpuTiming)
+        _frameGpuTimer->begin(mode);
+
     osgViewer::Viewer::frame(simulationTime);
+
+    if(_partialFrame)
+    {
+        _camera->getViewport()->setViewport(_partialViewport->x(), _partialViewport->y(),
+                                            _partialViewport->width(), _partialViewport->height());
+        _camera->setProjectionMatrix(_partialProjection);
+        _partialFrame = false;
+    }
+
+    if(multisample)
+    {
+        m_osgWinEmb->setDefaultFboId(resolveFramebuffer);
+
+        if(gpuTiming)
+            _resolveGpuTimer->begin();
+
+        _multisampleTarget->resolve(*context, resolveFramebuffer);
+
+        if(gpuTiming)
+            _resolveGpuTimer->end();
+    }
+
+    if(gpuTiming)
+    {
+        _frameGpuTimer->end();
+        collectAntialiasingTimes();
+    }
+
+    if(firstSceneFrame)
+    {
+        markStartup(FirstFrame);
+        OSG_INFO << "OSGRenderer: time to first frame " << startupTime(FirstFrame) * 1000.0
+                 << " ms, initializeGL " << startupTime(InitializeGL) * 1000.0
+                 << " ms, renderer created " << startupTime(RendererCreated) * 1000.0
+                 << " ms, scene ready " << startupTime(SceneReady) * 1000.0
+                 << " ms, first frame " << (startupTime(FirstFrame) - startupTime(FirstFrameStart)) * 1000.0
+                 << " ms" << std::endl;
+        emit firstFrame(startupTime(FirstFrame));
+    }
+
+    if(replaying)
+    {
+        // the duration covers the GPU work of the frame, not only its submission
+        if(context)
+            context->functions()->glFinish();
+
+        _inputRecorder->addFrameTiming(osg::Timer::instance()->delta_s(frameStartTick,
+                                                                       osg::Timer::instance()->tick()));
+        requestRedraw();
+    }
+    else if(_inputRecorder.valid() && _inputRecorder->isRecording())
+    {
+        _inputRecorder->nextFrame();
+    }
+
+    if(_retiredIdBufferPicker.valid() && _camera->getGraphicsContext())
+    {
+        _retiredIdBufferPicker->releaseGLObjects(_camera->getGraphicsContext()->getState());
+        _retiredIdBufferPicker = 0;
+    }
+
+    if(_idBufferPicker.valid())
+    {
+        IdBufferPicker::Result result;
+
+        if(_camera->getGraphicsContext())
+            _idBufferPicker->collectReadbacks(*_camera->getGraphicsContext()->getState());
+
+        while(_idBufferPicker->takeResult(result))
+        {
+            emit idPicked(result);
+        }
+
+        // readbacks still in flight are collected by the next frames
+        if(_idBufferPicker->hasPendingPicks())
+            requestRedraw();
+    }
+
+    // the update traversal is done, the scene can be described to the picking thread
+    if(_pickingService
+       && (pagerMerges
+           || _pickingScene != getSceneData()
+           || _pickingSceneModifiedCount != _sceneModifiedCount))
+    {
+        _pickingScene = getSceneData();
+        _pickingSceneModifiedCount = _sceneModifiedCount;
+        _pickingService->setScene(getSceneData());
+    }
+
+    // the context is still current, the objects of the frame have been applied
+    if(_gpuMemoryMonitor.valid() && _camera->getGraphicsContext())
+    {
+        osg::State& state = *_camera->getGraphicsContext()->getState();
+        // RGBA8 color and packed depth stencil
+        unsigned long long targetBytes = _offscreenTarget ?
+                                         8ull * _offscreenTarget->width() * _offscreenTarget->height() : 0;
+        _gpuMemoryMonitor->setExternalAllocation(state.getContextID(), "DebouncedResize target",
+                                                 GpuMemoryMonitor::RENDERBUFFER, targetBytes);
+        _gpuMemoryMonitor->setExternalAllocation(state.getContextID(), "Multisample target",
+                                                 GpuMemoryMonitor::RENDERBUFFER,
+                                                 _multisampleTarget.valid() ? _multisampleTarget->getAllocatedBytes() : 0);
+        _gpuMemoryMonitor->update(state, _camera.get());
+    }
+
+    if(_textureResidencyManager.valid() && _camera->getGraphicsContext())
+        _textureResidencyManager->evict(*_camera->getGraphicsContext()->getState());
+
+    // the new detail level is used from the next frame on
+    if(_frameBudgetGovernor.valid()
+       && _frameBudgetGovernor->addFrameTime(osg::Timer::instance()->delta_s(frameStartTick,
+                                                                              osg::Timer::instance()->tick())))
+    {
+        applyFrameBudget();
+    }
+
+    collectFrameStats();
+
+    if(_progressiveRefiner.valid())
+        _progressiveRefiner->endFrame(*_camera);
 #else
 
     if(_done) return;
@@ -494,22 +2001,110 @@ void OSGRenderer::frame(double simulationTime)
 #endif
 }
 
+void OSGRenderer::advance(double simulationTime)
+{
+    osgViewer::Viewer::advance(simulationTime);
+
+    // the reference time cuts off the events of the frame and times the manipulators,
+    // a FIXED_TIME replay runs it on the replay's clock
+    if(inputReplaying() && _inputRecorder->getTiming() == InputRecorder::FIXED_TIME)
+        _frameStamp->setReferenceTime(_frameStamp->getSimulationTime());
+}
+
+void OSGRenderer::eventTraversal()
+{
+    OSGQOPENGL_TRACE_ZONE("event");
+    osgViewer::Viewer::eventTraversal();
+}
+
+void OSGRenderer::updateTraversal()
+{
+    OSGQOPENGL_TRACE_ZONE("update");
+
+    {
+        OSGQOPENGL_TRACE_ZONE("scene commands");
+        _sceneCommandQueue->applyBatch();
+    }
+
+    osgViewer::Viewer::updateTraversal();
+
+    // the accumulation draws whole frames
+    if(_partialUpdate && !_progressive)
+        applyPartialUpdate();
+
+    // the camera and the scene are final for this frame
+    if(_progressive && !_interacting && getSceneData())
+        _progressiveRefiner->beginFrame(*_camera, _sceneModifiedCount);
+}
+
+void OSGRenderer::renderingTraversals()
+{
+    OSGQOPENGL_TRACE_ZONE("rendering");
+
+    bool presenting = _progressiveRefiner.valid() && _progressiveRefiner->isPresenting();
+    bool jittering = _progressiveRefiner.valid() && _progressiveRefiner->isJittering();
+
+    // the update traversal decided on the partial and accumulated frames with its view
+    if(_lateLatch && m_osgInitialized && !_partialFrame && !presenting && !jittering && !inputReplaying())
+        lateLatchCamera();
+
+    // nothing changed since the image converged, the window only needs it again
+    if(presenting && _camera->getGraphicsContext())
+    {
+        osg::RenderInfo renderInfo(_camera->getGraphicsContext()->getState(), this);
+        _progressiveRefiner->present(renderInfo);
+        _requestRedraw = false;
+        return;
+    }
+
+    osgViewer::Viewer::renderingTraversals();
+}
+
 void OSGRenderer::requestRedraw()
 {
     osgViewer::Viewer::requestRedraw();
 }
 
-void OSGRenderer::timerEvent(QTimerEvent* /*event*/)
+void OSGRenderer::timerEvent(QTimerEvent* event)
 {
+    if(event->timerId() == _resizeTimerId)
+    {
+        // the resize ended, render directly to the window again and keep the target
+        // for a while in case the window is resized again
+        killTimer(_resizeTimerId);
+        _resizeTimerId = 0;
+        _offscreenFrameValid = false;
+
+        if(_offscreenTarget)
+            _releaseTimerId = startTimer(_resizeReleaseDelay);
+
+        applyResize();
+        return;
+    }
+
+    if(event->timerId() == _releaseTimerId)
+    {
+        killTimer(_releaseTimerId);
+        _releaseTimerId = 0;
+        _releaseTargetRequested = true;
+        update();
+        return;
+    }
+
     // application is about to quit, just return
     if(_applicationAboutToQuit)
     {
         return;
     }
 
+    bool continuous = getRunFrameScheme() != osgViewer::ViewerBase::ON_DEMAND;
+
+    // frames are needed until the accumulation converged, then only when something changed
+    if(_progressive)
+        continuous = _interacting || !_progressiveRefiner->isConverged();
+
     // ask ViewerWidget to update 3D view
-    if(getRunFrameScheme() != osgViewer::ViewerBase::ON_DEMAND ||
-       checkNeedToDoFrame())
+    if(continuous || checkNeedToDoFrame())
     {
         update();
     }
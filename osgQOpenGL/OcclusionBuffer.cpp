@@ -0,0 +1,552 @@
+#include <osgQOpenGL/OcclusionBuffer>
+
+#include <osg/Math>
+#include <osg/TriangleFunctor>
+#include <osg/Transform>
+#include <osg/ValueObject>
+#include <osg/Timer>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define OSGQOPENGL_OCCLUSION_SSE2 1
+#   include <emmintrin.h>
+#endif
+
+namespace
+{
+    // clip space w below which a vertex is considered to be at or behind the eye.
+    const float MIN_CLIP_W = 1e-5f;
+
+    struct TriangleCollector
+    {
+        std::vector<osg::Vec3>* triangles;
+
+        void operator()(const osg::Vec3& v1, const osg::Vec3& v2, const osg::Vec3& v3)
+        {
+            triangles->push_back(v1);
+            triangles->push_back(v2);
+            triangles->push_back(v3);
+        }
+
+        void operator()(const osg::Vec3& v1, const osg::Vec3& v2, const osg::Vec3& v3, bool)
+        {
+            operator()(v1, v2, v3);
+        }
+    };
+
+    /// Gather the drawables below an occluder with their local to world matrices.
+    class OccluderDrawableVisitor : public osg::NodeVisitor
+    {
+    public:
+        typedef std::vector< std::pair<osg::Drawable*, osg::Matrix> > DrawableList;
+
+        OccluderDrawableVisitor(const osg::Matrix& localToWorld) :
+            osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
+            _matrix(localToWorld) {}
+
+        virtual void apply(osg::Transform& transform)
+        {
+            osg::Matrix previous = _matrix;
+            transform.computeLocalToWorldMatrix(_matrix, this);
+            traverse(transform);
+            _matrix = previous;
+        }
+
+        virtual void apply(osg::Drawable& drawable)
+        {
+            _drawables.push_back(std::make_pair(&drawable, _matrix));
+        }
+
+        osg::Matrix     _matrix;
+        DrawableList    _drawables;
+    };
+
+    /// Find the nodes flagged as occluders and the drawables large enough to be one.
+    class CollectOccludersVisitor : public osg::NodeVisitor
+    {
+    public:
+        CollectOccludersVisitor(const std::string& userValueName, float minimumRadius) :
+            osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
+            _userValueName(userValueName),
+            _minimumRadius(minimumRadius) {}
+
+        virtual void apply(osg::Node& node)
+        {
+            if(isFlagged(node))
+                _flagged.push_back(&node);
+            else
+                traverse(node);
+        }
+
+        virtual void apply(osg::Drawable& drawable)
+        {
+            if(isFlagged(drawable))
+                _flagged.push_back(&drawable);
+            else if(_minimumRadius > 0.0f && drawable.getBound().radius() >= _minimumRadius)
+                _candidates.push_back(&drawable);
+        }
+
+        bool isFlagged(const osg::Node& node) const
+        {
+            bool flag = false;
+            return !_userValueName.empty() && node.getUserValue(_userValueName, flag) && flag;
+        }
+
+        std::string                 _userValueName;
+        float                       _minimumRadius;
+        std::vector<osg::Node*>     _flagged;
+        std::vector<osg::Drawable*> _candidates;
+    };
+}
+
+OcclusionBuffer::OcclusionBuffer() :
+    _width(0),
+    _height(0),
+    _occluderUserValueName("occluder"),
+    _autoOccluderMinimumRadius(0.0f),
+    _maxAutoOccluderTriangles(256),
+    _maxOccluderTriangles(16384),
+    _minimumTestSize(2.0f),
+    _numRasterizedTriangles(0)
+{
+    setResolution(256, 128);
+}
+
+void OcclusionBuffer::setResolution(unsigned int width, unsigned int height)
+{
+    _width = std::max(4u, (width + 3) & ~3u);
+    _height = std::max(1u, height);
+
+    _levels.clear();
+    _levelWidths.clear();
+    _levelHeights.clear();
+
+    unsigned int w = _width;
+    unsigned int h = _height;
+
+    for(;;)
+    {
+        _levels.push_back(DepthLevel(w * h, 1.0f));
+        _levelWidths.push_back(w);
+        _levelHeights.push_back(h);
+
+        if(w == 1 && h == 1)
+            break;
+
+        w = std::max(1u, (w + 1) / 2);
+        h = std::max(1u, (h + 1) / 2);
+    }
+}
+
+void OcclusionBuffer::reportStats(osg::Stats& stats, unsigned int frameNumber) const
+{
+    stats.setAttribute(frameNumber, "Occlusion occluders", _stats.numOccluders);
+    stats.setAttribute(frameNumber, "Occlusion occluder triangles", _stats.numOccluderTriangles);
+    stats.setAttribute(frameNumber, "Occlusion tests", _stats.numTests);
+    stats.setAttribute(frameNumber, "Occlusion culled nodes", _stats.numCulledNodes);
+    stats.setAttribute(frameNumber, "Occlusion culled drawables", _stats.numCulledDrawables);
+    stats.setAttribute(frameNumber, "Occlusion rasterize time taken", _stats.rasterizeTime);
+    stats.setAttribute(frameNumber, "Occlusion test time taken", _stats.testTime);
+}
+
+void OcclusionBuffer::addOccluder(osg::Node* node)
+{
+    if(!node)
+        return;
+
+    for(OccluderList::iterator itr = _occluders.begin(); itr != _occluders.end(); ++itr)
+    {
+        if(*itr == node)
+            return;
+    }
+
+    _occluders.push_back(node);
+}
+
+void OcclusionBuffer::removeOccluder(osg::Node* node)
+{
+    for(OccluderList::iterator itr = _occluders.begin(); itr != _occluders.end(); ++itr)
+    {
+        if(*itr == node)
+        {
+            _occluders.erase(itr);
+            return;
+        }
+    }
+}
+
+void OcclusionBuffer::clearOccluders()
+{
+    _occluders.clear();
+    _collectedOccluders.clear();
+    _triangleCache.clear();
+}
+
+void OcclusionBuffer::collectOccluders(osg::Node* root)
+{
+    _collectedOccluders.clear();
+    // drop the triangles of drawables that may have been removed from the scene.
+    _triangleCache.clear();
+
+    if(!root)
+        return;
+
+    CollectOccludersVisitor visitor(_occluderUserValueName, _autoOccluderMinimumRadius);
+    root->accept(visitor);
+
+    for(std::vector<osg::Node*>::iterator itr = visitor._flagged.begin();
+        itr != visitor._flagged.end();
+        ++itr)
+    {
+        _collectedOccluders.push_back(*itr);
+    }
+
+    for(std::vector<osg::Drawable*>::iterator itr = visitor._candidates.begin();
+        itr != visitor._candidates.end();
+        ++itr)
+    {
+        if(getTriangles(*itr).size() / 3 <= _maxAutoOccluderTriangles)
+            _collectedOccluders.push_back(*itr);
+    }
+}
+
+const OcclusionBuffer::TriangleList& OcclusionBuffer::getTriangles(osg::Drawable* drawable)
+{
+    TriangleCache::iterator itr = _triangleCache.find(drawable);
+
+    if(itr != _triangleCache.end())
+        return itr->second;
+
+    TriangleList& triangles = _triangleCache[drawable];
+    osg::TriangleFunctor<TriangleCollector> collector;
+    collector.triangles = &triangles;
+    drawable->accept(collector);
+    return triangles;
+}
+
+void OcclusionBuffer::addOccluderDrawables(osg::Node* node)
+{
+    osg::MatrixList matrices = node->getWorldMatrices();
+    OccluderDrawableVisitor visitor(matrices.empty() ? osg::Matrix::identity() :
+                                    matrices.front());
+
+    // the world matrices already include the occluder itself if it is a transform.
+    if(node->asDrawable())
+        visitor.apply(*node->asDrawable());
+    else
+        node->traverse(visitor);
+
+    for(OccluderDrawableVisitor::DrawableList::iterator itr = visitor._drawables.begin();
+        itr != visitor._drawables.end();
+        ++itr)
+    {
+        OccluderDrawable od;
+        od.triangles = &getTriangles(itr->first);
+        od.localToWorld = itr->second;
+        _occluderDrawables.push_back(od);
+    }
+
+    ++_stats.numOccluders;
+}
+
+void OcclusionBuffer::rasterize(const osg::Matrix& view, const osg::Matrix& projection)
+{
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+
+    _numRasterizedTriangles = 0;
+    std::fill(_levels[0].begin(), _levels[0].end(), 1.0f);
+
+    _occluderDrawables.clear();
+
+    for(OccluderList::iterator itr = _occluders.begin(); itr != _occluders.end(); ++itr)
+    {
+        osg::ref_ptr<osg::Node> node;
+
+        if(itr->lock(node))
+            addOccluderDrawables(node.get());
+    }
+
+    for(OccluderList::iterator itr = _collectedOccluders.begin(); itr != _collectedOccluders.end();
+        ++itr)
+    {
+        osg::ref_ptr<osg::Node> node;
+
+        if(itr->lock(node))
+            addOccluderDrawables(node.get());
+    }
+
+    osg::Matrix viewProjection = view * projection;
+
+    for(OccluderDrawableList::iterator itr = _occluderDrawables.begin();
+        itr != _occluderDrawables.end() && _numRasterizedTriangles < _maxOccluderTriangles;
+        ++itr)
+    {
+        osg::Matrix mvp = itr->localToWorld * viewProjection;
+        const TriangleList& triangles = *itr->triangles;
+
+        for(std::size_t i = 0;
+            i + 2 < triangles.size() && _numRasterizedTriangles < _maxOccluderTriangles;
+            i += 3)
+        {
+            rasterizeTriangle(osg::Vec4(triangles[i], 1.0f) * mvp,
+                              osg::Vec4(triangles[i + 1], 1.0f) * mvp,
+                              osg::Vec4(triangles[i + 2], 1.0f) * mvp);
+            ++_numRasterizedTriangles;
+            ++_stats.numOccluderTriangles;
+        }
+    }
+
+    buildHierarchy();
+
+    _stats.rasterizeTime += osg::Timer::instance()->delta_s(startTick,
+                                                           osg::Timer::instance()->tick());
+}
+
+void OcclusionBuffer::rasterizeTriangle(const osg::Vec4& c0, const osg::Vec4& c1,
+                                        const osg::Vec4& c2)
+{
+    // triangles crossing the near plane are skipped, which only makes the buffer
+    // more conservative.
+    if(c0.w() < MIN_CLIP_W || c1.w() < MIN_CLIP_W || c2.w() < MIN_CLIP_W)
+        return;
+
+    const float w = static_cast<float>(_width);
+    const float h = static_cast<float>(_height);
+
+    float x[3], y[3], z[3];
+    const osg::Vec4* c[3] = { &c0, &c1, &c2 };
+
+    for(int i = 0; i < 3; ++i)
+    {
+        float invW = 1.0f / c[i]->w();
+        x[i] = (c[i]->x() * invW * 0.5f + 0.5f) * w;
+        y[i] = (c[i]->y() * invW * 0.5f + 0.5f) * h;
+        z[i] = osg::clampBetween(c[i]->z() * invW * 0.5f + 0.5f, 0.0f, 1.0f);
+    }
+
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+
+    if(std::fabs(area) < 1e-8f)
+        return;
+
+    // make the triangle counter clockwise so that inside means all edges positive.
+    if(area < 0.0f)
+    {
+        std::swap(x[1], x[2]);
+        std::swap(y[1], y[2]);
+        std::swap(z[1], z[2]);
+        area = -area;
+    }
+
+    int minX = std::max(0, static_cast<int>(std::floor(std::min(x[0], std::min(x[1], x[2])))));
+    int maxX = std::min(static_cast<int>(_width) - 1,
+                        static_cast<int>(std::floor(std::max(x[0], std::max(x[1], x[2])))));
+    int minY = std::max(0, static_cast<int>(std::floor(std::min(y[0], std::min(y[1], y[2])))));
+    int maxY = std::min(static_cast<int>(_height) - 1,
+                        static_cast<int>(std::floor(std::max(y[0], std::max(y[1], y[2])))));
+
+    if(minX > maxX || minY > maxY)
+        return;
+
+    // edge i is opposite to vertex i, its value is the barycentric weight of vertex i.
+    float ex[3], ey[3], ec[3];
+
+    for(int i = 0; i < 3; ++i)
+    {
+        int a = (i + 1) % 3;
+        int b = (i + 2) % 3;
+        ex[i] = -(y[b] - y[a]);
+        ey[i] = x[b] - x[a];
+        ec[i] = -(ex[i] * x[a] + ey[i] * y[a]);
+    }
+
+    const float invArea = 1.0f / area;
+    // depth is linear in screen space: z = zx * px + zy * py + zc
+    const float zx = (ex[0] * z[0] + ex[1] * z[1] + ex[2] * z[2]) * invArea;
+    const float zy = (ey[0] * z[0] + ey[1] * z[1] + ey[2] * z[2]) * invArea;
+    // the depth written for a texel is the farthest one of the triangle within it.
+    const float zc = (ec[0] * z[0] + ec[1] * z[1] + ec[2] * z[2]) * invArea
+                     + 0.5f * (std::fabs(zx) + std::fabs(zy));
+
+    // the edge values are evaluated at texel centers, move the edges inwards by
+    // half a texel so that only the texels entirely inside the triangle are covered.
+    for(int i = 0; i < 3; ++i)
+        ec[i] -= 0.5f * (std::fabs(ex[i]) + std::fabs(ey[i]));
+
+    // start on a multiple of 4 so that blocks of 4 pixels never leave the row.
+    const int startX = minX & ~3;
+    const float px0 = static_cast<float>(startX) + 0.5f;
+
+    DepthLevel& depth = _levels[0];
+
+    for(int py = minY; py <= maxY; ++py)
+    {
+        const float pyc = static_cast<float>(py) + 0.5f;
+        float* row = &depth[py * _width];
+
+        float e0 = ex[0] * px0 + ey[0] * pyc + ec[0];
+        float e1 = ex[1] * px0 + ey[1] * pyc + ec[1];
+        float e2 = ex[2] * px0 + ey[2] * pyc + ec[2];
+        float zr = zx * px0 + zy * pyc + zc;
+
+#ifdef OSGQOPENGL_OCCLUSION_SSE2
+        const __m128 offsets = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+        const __m128 zero = _mm_setzero_ps();
+        __m128 e0v = _mm_add_ps(_mm_set1_ps(e0), _mm_mul_ps(offsets, _mm_set1_ps(ex[0])));
+        __m128 e1v = _mm_add_ps(_mm_set1_ps(e1), _mm_mul_ps(offsets, _mm_set1_ps(ex[1])));
+        __m128 e2v = _mm_add_ps(_mm_set1_ps(e2), _mm_mul_ps(offsets, _mm_set1_ps(ex[2])));
+        __m128 zv = _mm_add_ps(_mm_set1_ps(zr), _mm_mul_ps(offsets, _mm_set1_ps(zx)));
+        const __m128 e0Step = _mm_set1_ps(4.0f * ex[0]);
+        const __m128 e1Step = _mm_set1_ps(4.0f * ex[1]);
+        const __m128 e2Step = _mm_set1_ps(4.0f * ex[2]);
+        const __m128 zStep = _mm_set1_ps(4.0f * zx);
+
+        for(int px = startX; px <= maxX; px += 4)
+        {
+            __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0v, zero), _mm_cmpge_ps(e1v, zero)),
+                                       _mm_cmpge_ps(e2v, zero));
+
+            if(_mm_movemask_ps(inside))
+            {
+                __m128 current = _mm_loadu_ps(row + px);
+                __m128 nearest = _mm_min_ps(current, _mm_max_ps(zv, zero));
+                _mm_storeu_ps(row + px, _mm_or_ps(_mm_and_ps(inside, nearest),
+                                                  _mm_andnot_ps(inside, current)));
+            }
+
+            e0v = _mm_add_ps(e0v, e0Step);
+            e1v = _mm_add_ps(e1v, e1Step);
+            e2v = _mm_add_ps(e2v, e2Step);
+            zv = _mm_add_ps(zv, zStep);
+        }
+
+#else
+
+        for(int px = startX; px <= maxX; ++px)
+        {
+            if(e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f)
+                row[px] = std::min(row[px], std::max(zr, 0.0f));
+
+            e0 += ex[0];
+            e1 += ex[1];
+            e2 += ex[2];
+            zr += zx;
+        }
+
+#endif
+    }
+}
+
+void OcclusionBuffer::buildHierarchy()
+{
+    // each coarser level keeps the farthest depth of the 2x2 texels below it.
+    for(std::size_t level = 1; level < _levels.size(); ++level)
+    {
+        const DepthLevel& fine = _levels[level - 1];
+        DepthLevel& coarse = _levels[level];
+        const unsigned int fw = _levelWidths[level - 1];
+        const unsigned int fh = _levelHeights[level - 1];
+        const unsigned int cw = _levelWidths[level];
+        const unsigned int ch = _levelHeights[level];
+
+        for(unsigned int y = 0; y < ch; ++y)
+        {
+            unsigned int y0 = std::min(2 * y, fh - 1);
+            unsigned int y1 = std::min(2 * y + 1, fh - 1);
+
+            for(unsigned int x = 0; x < cw; ++x)
+            {
+                unsigned int x0 = std::min(2 * x, fw - 1);
+                unsigned int x1 = std::min(2 * x + 1, fw - 1);
+                coarse[y * cw + x] = std::max(std::max(fine[y0 * fw + x0], fine[y0 * fw + x1]),
+                                              std::max(fine[y1 * fw + x0], fine[y1 * fw + x1]));
+            }
+        }
+    }
+}
+
+bool OcclusionBuffer::isOccluded(const osg::BoundingBox& bb, const osg::Matrix& modelViewProjection)
+{
+    if(_numRasterizedTriangles == 0 || !bb.valid())
+        return false;
+
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+    ++_stats.numTests;
+
+    float minX = FLT_MAX, minY = FLT_MAX, minZ = FLT_MAX;
+    float maxX = -FLT_MAX, maxY = -FLT_MAX;
+    bool occluded = true;
+
+    for(unsigned int i = 0; i < 8; ++i)
+    {
+        osg::Vec4 c = osg::Vec4(bb.corner(i), 1.0f) * modelViewProjection;
+
+        // boxes reaching behind the eye are always considered visible.
+        if(c.w() < MIN_CLIP_W)
+        {
+            occluded = false;
+            break;
+        }
+
+        float invW = 1.0f / c.w();
+        float x = (c.x() * invW * 0.5f + 0.5f) * static_cast<float>(_width);
+        float y = (c.y() * invW * 0.5f + 0.5f) * static_cast<float>(_height);
+        float z = c.z() * invW * 0.5f + 0.5f;
+
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        minZ = std::min(minZ, z);
+    }
+
+    if(occluded)
+    {
+        // off screen boxes are left to the frustum culling, and tiny ones are
+        // cheaper to draw than to test.
+        if(maxX < 0.0f || maxY < 0.0f
+           || minX >= static_cast<float>(_width) || minY >= static_cast<float>(_height)
+           || std::max(maxX - minX, maxY - minY) < _minimumTestSize)
+        {
+            occluded = false;
+        }
+    }
+
+    if(occluded)
+    {
+        int x0 = std::max(0, static_cast<int>(std::floor(minX)));
+        int x1 = std::min(static_cast<int>(_width) - 1, static_cast<int>(std::floor(maxX)));
+        int y0 = std::max(0, static_cast<int>(std::floor(minY)));
+        int y1 = std::min(static_cast<int>(_height) - 1, static_cast<int>(std::floor(maxY)));
+
+        // pick the level where the box covers at most 4x4 texels.
+        std::size_t level = 0;
+
+        while(level + 1 < _levels.size() && ((x1 >> level) - (x0 >> level) > 3
+                                              || (y1 >> level) - (y0 >> level) > 3))
+        {
+            ++level;
+        }
+
+        const DepthLevel& depth = _levels[level];
+        const unsigned int lw = _levelWidths[level];
+
+        for(int y = y0 >> level; occluded && y <= (y1 >> level); ++y)
+        {
+            for(int x = x0 >> level; x <= (x1 >> level); ++x)
+            {
+                if(depth[y * lw + x] >= minZ)
+                {
+                    occluded = false;
+                    break;
+                }
+            }
+        }
+    }
+
+    _stats.testTime += osg::Timer::instance()->delta_s(startTick, osg::Timer::instance()->tick());
+    return occluded;
+}
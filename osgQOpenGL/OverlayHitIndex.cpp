@@ -0,0 +1,99 @@
+#include <osgQOpenGL/OverlayHitIndex>
+
+#include <algorithm>
+#include <cmath>
+
+OverlayHitIndex::OverlayHitIndex() :
+    _columns(0),
+    _rows(0),
+    _cellWidth(1.0),
+    _cellHeight(1.0)
+{
+}
+
+void OverlayHitIndex::clear()
+{
+    _rects.clear();
+    _bounds = QRectF();
+    _columns = _rows = 0;
+    _cellStart.clear();
+    _cellRects.clear();
+}
+
+void OverlayHitIndex::cellRange(const QRectF& rect, int& column0, int& row0, int& column1, int& row1) const
+{
+    column0 = std::max(static_cast<int>((rect.left() - _bounds.left()) / _cellWidth), 0);
+    row0 = std::max(static_cast<int>((rect.top() - _bounds.top()) / _cellHeight), 0);
+    column1 = std::min(static_cast<int>((rect.right() - _bounds.left()) / _cellWidth), _columns - 1);
+    row1 = std::min(static_cast<int>((rect.bottom() - _bounds.top()) / _cellHeight), _rows - 1);
+}
+
+void OverlayHitIndex::build(const std::vector<QRectF>& rects)
+{
+    clear();
+
+    for(std::vector<QRectF>::const_iterator itr = rects.begin(); itr != rects.end(); ++itr)
+    {
+        if(itr->isEmpty())
+            continue;
+
+        _rects.push_back(*itr);
+        _bounds |= *itr;
+    }
+
+    if(_rects.empty())
+        return;
+
+    // about one rectangle per cell for rectangles spread evenly
+    int cells = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(_rects.size()))));
+    _columns = std::min(std::max(cells, 1), 64);
+    _rows = _columns;
+    _cellWidth = std::max(_bounds.width() / _columns, 1e-6);
+    _cellHeight = std::max(_bounds.height() / _rows, 1e-6);
+
+    // count the rectangles of each cell, then fill the ranges
+    _cellStart.assign(_columns * _rows + 1, 0);
+    int column0, row0, column1, row1;
+
+    for(unsigned int i = 0; i < _rects.size(); ++i)
+    {
+        cellRange(_rects[i], column0, row0, column1, row1);
+
+        for(int row = row0; row <= row1; ++row)
+            for(int column = column0; column <= column1; ++column)
+                ++_cellStart[row * _columns + column + 1];
+    }
+
+    for(unsigned int cell = 1; cell < _cellStart.size(); ++cell)
+        _cellStart[cell] += _cellStart[cell - 1];
+
+    _cellRects.resize(_cellStart.back());
+    std::vector<unsigned int> next(_cellStart.begin(), _cellStart.end() - 1);
+
+    for(unsigned int i = 0; i < _rects.size(); ++i)
+    {
+        cellRange(_rects[i], column0, row0, column1, row1);
+
+        for(int row = row0; row <= row1; ++row)
+            for(int column = column0; column <= column1; ++column)
+                _cellRects[next[row * _columns + column]++] = i;
+    }
+}
+
+bool OverlayHitIndex::contains(const QPointF& point) const
+{
+    if(_rects.empty() || !_bounds.contains(point))
+        return false;
+
+    int column = std::min(static_cast<int>((point.x() - _bounds.left()) / _cellWidth), _columns - 1);
+    int row = std::min(static_cast<int>((point.y() - _bounds.top()) / _cellHeight), _rows - 1);
+    unsigned int cell = row * _columns + column;
+
+    for(unsigned int i = _cellStart[cell]; i < _cellStart[cell + 1]; ++i)
+    {
+        if(_rects[_cellRects[i]].contains(point))
+            return true;
+    }
+
+    return false;
+}
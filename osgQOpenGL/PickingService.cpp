@@ -0,0 +1,534 @@
+#include <osgQOpenGL/PickingService>
+#include <osgQOpenGL/FrameTracer>
+
+#include <osg/NodeVisitor>
+#include <osg/TriangleIndexFunctor>
+
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+    const unsigned int BVH_LEAF_SIZE = 4;
+
+    // segment parameter range [tmin, tmax] inside the box, false if it misses it.
+    bool intersectBox(const osg::BoundingBox& bb, const osg::Vec3d& start,
+                      const osg::Vec3d& inverseDir, double& tmin, double& tmax)
+    {
+        for(unsigned int i = 0; i < 3; ++i)
+        {
+            double t0 = (bb._min[i] - start[i]) * inverseDir[i];
+            double t1 = (bb._max[i] - start[i]) * inverseDir[i];
+
+            if(t0 > t1)
+                std::swap(t0, t1);
+
+            tmin = std::max(tmin, t0);
+            tmax = std::min(tmax, t1);
+
+            if(tmin > tmax)
+                return false;
+        }
+
+        return true;
+    }
+
+    template<class T>
+    struct CenterLess
+    {
+        explicit CenterLess(unsigned int a) : axis(a) {}
+
+        bool operator()(const T& lhs, const T& rhs) const
+        {
+            return lhs.v0[axis] + lhs.v1[axis] + lhs.v2[axis] <
+                   rhs.v0[axis] + rhs.v1[axis] + rhs.v2[axis];
+        }
+
+        unsigned int axis;
+    };
+
+    osg::Vec3d inverseDirection(const osg::Vec3d& dir)
+    {
+        const double inf = std::numeric_limits<double>::infinity();
+        return osg::Vec3d(dir.x() != 0.0 ? 1.0 / dir.x() : inf,
+                          dir.y() != 0.0 ? 1.0 / dir.y() : inf,
+                          dir.z() != 0.0 ? 1.0 / dir.z() : inf);
+    }
+
+    // Moller-Trumbore, segment parameter of the hit in t.
+    bool intersectTriangle(const osg::Vec3d& start, const osg::Vec3d& dir,
+                           const osg::Vec3d& v0, const osg::Vec3d& v1, const osg::Vec3d& v2,
+                           double& t)
+    {
+        osg::Vec3d e1 = v1 - v0;
+        osg::Vec3d e2 = v2 - v0;
+        osg::Vec3d p = dir ^ e2;
+        double det = e1 * p;
+
+        if(det == 0.0)
+            return false;
+
+        double invDet = 1.0 / det;
+        osg::Vec3d s = start - v0;
+        double u = (s * p) * invDet;
+
+        if(u < 0.0 || u > 1.0)
+            return false;
+
+        osg::Vec3d q = s ^ e1;
+        double v = (dir * q) * invDet;
+
+        if(v < 0.0 || u + v > 1.0)
+            return false;
+
+        t = (e2 * q) * invDet;
+        return true;
+    }
+}
+
+class PickingService::SnapshotVisitor : public osg::NodeVisitor
+{
+public:
+    SnapshotVisitor(osg::Node::NodeMask mask, Snapshot* snapshot, const BvhCache& previous,
+                    BvhCache& current) :
+        osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ACTIVE_CHILDREN),
+        _snapshot(snapshot),
+        _previous(previous),
+        _current(current)
+    {
+        setTraversalMask(mask);
+    }
+
+    virtual void apply(osg::Drawable& drawable)
+    {
+        osg::Geometry* geometry = drawable.asGeometry();
+
+        if(!geometry || !dynamic_cast<const osg::Vec3Array*>(geometry->getVertexArray()))
+            return;
+
+        const osg::BoundingBox& bb = geometry->getBoundingBox();
+
+        if(!bb.valid())
+            return;
+
+        Entry entry;
+        entry.nodePath.assign(getNodePath().begin(), getNodePath().end());
+        entry.geometry = geometry;
+        entry.localToWorld = osg::computeLocalToWorld(getNodePath());
+        entry.worldToLocal = osg::Matrixd::inverse(entry.localToWorld);
+
+        for(unsigned int i = 0; i < 8; ++i)
+        {
+            entry.worldBound.expandBy(bb.corner(i) * entry.localToWorld);
+        }
+
+        entry.bvh = getBvh(geometry);
+        _snapshot->entries.push_back(entry);
+    }
+
+protected:
+    // the copy of the previous snapshot while the geometry is unchanged, a new one otherwise
+    Bvh* getBvh(osg::Geometry* geometry)
+    {
+        BvhCache::iterator itr = _current.find(geometry);
+
+        if(itr != _current.end())
+            return itr->second.get();
+
+        BvhCache::const_iterator pitr = _previous.find(geometry);
+        Bvh* bvh;
+
+        if(pitr != _previous.end()
+           && pitr->second->vertexModifiedCount == geometry->getVertexArray()->getModifiedCount()
+           && pitr->second->numPrimitiveSets == geometry->getNumPrimitiveSets())
+        {
+            bvh = pitr->second.get();
+        }
+        else
+        {
+            bvh = copyTriangles(geometry);
+        }
+
+        _current[geometry] = bvh;
+        return bvh;
+    }
+
+    Snapshot*       _snapshot;
+    const BvhCache& _previous;
+    BvhCache&       _current;
+};
+
+struct PickingService::TriangleCollector
+{
+    TriangleCollector() :
+        vertices(0),
+        triangles(0),
+        numTriangles(0) {}
+
+    void operator()(unsigned int i1, unsigned int i2, unsigned int i3)
+    {
+        unsigned int index = numTriangles++;
+
+        if(i1 >= vertices->size() || i2 >= vertices->size() || i3 >= vertices->size())
+            return;
+
+        Triangle triangle;
+        triangle.v0 = (*vertices)[i1];
+        triangle.v1 = (*vertices)[i2];
+        triangle.v2 = (*vertices)[i3];
+        triangle.index = index;
+        triangles->push_back(triangle);
+    }
+
+    const osg::Vec3Array*   vertices;
+    std::vector<Triangle>*  triangles;
+    unsigned int            numTriangles;
+};
+
+PickingService::PickingService(QObject* parent) :
+    QThread(parent)
+{
+    qRegisterMetaType<PickingService::PickResult>();
+    start(QThread::LowPriority);
+}
+
+PickingService::~PickingService()
+{
+    requestInterruption();
+
+    {
+        QMutexLocker locker(&_mutex);
+        _condition.wakeAll();
+    }
+
+    wait();
+}
+
+void PickingService::setScene(osg::Node* scene)
+{
+    OSGQOPENGL_TRACE_ZONE("picking snapshot");
+    osg::ref_ptr<Snapshot> snapshot = new Snapshot();
+    BvhCache cache;
+
+    if(scene)
+    {
+        SnapshotVisitor visitor(_traversalMask, snapshot.get(), _bvhCache, cache);
+        scene->accept(visitor);
+    }
+
+    // the copies of removed geometries go away with the last snapshot using them
+    _bvhCache.swap(cache);
+
+    QMutexLocker locker(&_mutex);
+    _snapshot = snapshot;
+    _snapshotChanged = true;
+    _condition.wakeAll();
+}
+
+unsigned int PickingService::pick(osg::Camera* camera, double x, double y)
+{
+    if(!camera || !camera->getViewport())
+        return 0;
+
+    osg::Matrixd windowMatrix = camera->getViewMatrix()
+                                * camera->getProjectionMatrix()
+                                * camera->getViewport()->computeWindowMatrix();
+    osg::Matrixd inverse = osg::Matrixd::inverse(windowMatrix);
+
+    QMutexLocker locker(&_mutex);
+
+    if(_requestPending)
+        ++_stats.numDroppedRequests;
+
+    ++_stats.numRequests;
+
+    _request.id = _nextRequestId++;
+    _request.x = x;
+    _request.y = y;
+    _request.start = osg::Vec3d(x, y, 0.0) * inverse;
+    _request.end = osg::Vec3d(x, y, 1.0) * inverse;
+    _request.tick = osg::Timer::instance()->tick();
+    _requestPending = true;
+    _condition.wakeAll();
+
+    return _request.id;
+}
+
+PickingService::Stats PickingService::stats() const
+{
+    QMutexLocker locker(&_mutex);
+    return _stats;
+}
+
+void PickingService::resetStats()
+{
+    QMutexLocker locker(&_mutex);
+    _stats = Stats();
+}
+
+void PickingService::run()
+{
+    osg::ref_ptr<Snapshot> snapshot;
+
+    FrameTracer::instance()->setThreadName("picking");
+
+    while(!isInterruptionRequested())
+    {
+        Request request;
+        bool hasRequest = false;
+
+        {
+            QMutexLocker locker(&_mutex);
+
+            // sleep until there is a pick to do or a BVH left to build
+            while(!isInterruptionRequested()
+                  && !_requestPending
+                  && !_snapshotChanged
+                  && !(snapshot.valid() && _nextBuild < snapshot->entries.size()))
+            {
+                _condition.wait(&_mutex);
+            }
+
+            if(_snapshotChanged)
+            {
+                snapshot = _snapshot;
+                _snapshotChanged = false;
+                _nextBuild = 0;
+            }
+
+            if(_requestPending)
+            {
+                request = _request;
+                hasRequest = true;
+                _requestPending = false;
+            }
+        }
+
+        if(isInterruptionRequested())
+            break;
+
+        if(hasRequest)
+        {
+            OSGQOPENGL_TRACE_ZONE("pick");
+            osg::Timer_t startTick = osg::Timer::instance()->tick();
+            PickResult result = intersect(snapshot.get(), request);
+            osg::Timer_t endTick = osg::Timer::instance()->tick();
+            result.latency = osg::Timer::instance()->delta_s(request.tick, endTick);
+
+            {
+                QMutexLocker locker(&_mutex);
+                ++_stats.numPicks;
+
+                if(!result.ready)
+                    ++_stats.numNotReadyPicks;
+
+                _stats.pickTime += osg::Timer::instance()->delta_s(startTick, endTick);
+                _stats.totalLatency += result.latency;
+                _stats.maxLatency = std::max(_stats.maxLatency, result.latency);
+            }
+
+            emit picked(result);
+        }
+        else if(snapshot.valid())
+        {
+            buildNextBvh(snapshot.get());
+        }
+    }
+}
+
+bool PickingService::buildNextBvh(Snapshot* snapshot)
+{
+    // one BVH per call, so that a pick request waits for at most one build
+    while(_nextBuild < snapshot->entries.size())
+    {
+        Bvh* bvh = snapshot->entries[_nextBuild++].bvh.get();
+
+        if(!bvh->built)
+        {
+            buildBvh(*bvh);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+PickingService::Bvh* PickingService::copyTriangles(osg::Geometry* geometry)
+{
+    osg::ref_ptr<Bvh> bvh = new Bvh();
+    bvh->geometry = geometry;
+    bvh->vertexModifiedCount = geometry->getVertexArray()->getModifiedCount();
+    bvh->numPrimitiveSets = geometry->getNumPrimitiveSets();
+
+    osg::TriangleIndexFunctor<TriangleCollector> collector;
+    collector.vertices = static_cast<const osg::Vec3Array*>(geometry->getVertexArray());
+    collector.triangles = &bvh->triangles;
+    geometry->accept(collector);
+
+    return bvh.release();
+}
+
+void PickingService::buildBvh(Bvh& bvh)
+{
+    OSGQOPENGL_TRACE_ZONE("build BVH");
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+
+    if(!bvh.triangles.empty())
+    {
+        bvh.nodes.reserve(2 * bvh.triangles.size() / BVH_LEAF_SIZE + 1);
+        bvh.nodes.resize(1);
+        buildNode(bvh, 0, 0, bvh.triangles.size());
+    }
+
+    bvh.built = true;
+
+    QMutexLocker locker(&_mutex);
+    ++_stats.numBvhBuilds;
+    _stats.numBvhTriangles += bvh.triangles.size();
+    _stats.bvhBuildTime += osg::Timer::instance()->delta_s(startTick,
+                                                           osg::Timer::instance()->tick());
+}
+
+void PickingService::buildNode(Bvh& bvh, unsigned int nodeIndex, unsigned int first,
+                               unsigned int count)
+{
+    osg::BoundingBox bb;
+    osg::BoundingBox centers;
+
+    for(unsigned int i = first; i < first + count; ++i)
+    {
+        const Triangle& triangle = bvh.triangles[i];
+        bb.expandBy(triangle.v0);
+        bb.expandBy(triangle.v1);
+        bb.expandBy(triangle.v2);
+        centers.expandBy((triangle.v0 + triangle.v1 + triangle.v2) / 3.0f);
+    }
+
+    bvh.nodes[nodeIndex].bb = bb;
+
+    if(count <= BVH_LEAF_SIZE)
+    {
+        bvh.nodes[nodeIndex].first = first;
+        bvh.nodes[nodeIndex].count = count;
+        return;
+    }
+
+    // median split along the longest axis of the triangle centers
+    osg::Vec3 extent = centers._max - centers._min;
+    unsigned int axis = extent.x() > extent.y() ? (extent.x() > extent.z() ? 0 : 2) :
+                        (extent.y() > extent.z() ? 1 : 2);
+    unsigned int half = count / 2;
+
+    std::nth_element(bvh.triangles.begin() + first, bvh.triangles.begin() + first + half,
+                     bvh.triangles.begin() + first + count, CenterLess<Triangle>(axis));
+
+    unsigned int children = bvh.nodes.size();
+    bvh.nodes[nodeIndex].first = children;
+    bvh.nodes[nodeIndex].count = 0;
+    bvh.nodes.resize(children + 2);
+
+    buildNode(bvh, children, first, half);
+    buildNode(bvh, children + 1, first + half, count - half);
+}
+
+PickingService::PickResult PickingService::intersect(Snapshot* snapshot, const Request& request)
+{
+    PickResult result;
+    result.requestId = request.id;
+    result.x = request.x;
+    result.y = request.y;
+
+    if(!snapshot)
+        return result;
+
+    osg::Vec3d worldDir = request.end - request.start;
+    osg::Vec3d worldInverseDir = inverseDirection(worldDir);
+
+    double nearest = std::numeric_limits<double>::max();
+    const Entry* nearestEntry = 0;
+    Triangle nearestTriangle;
+
+    std::vector<unsigned int> stack;
+
+    for(std::vector<Entry>::const_iterator itr = snapshot->entries.begin();
+        itr != snapshot->entries.end();
+        ++itr)
+    {
+        double tmin = 0.0;
+        double tmax = std::min(1.0, nearest);
+
+        if(!intersectBox(itr->worldBound, request.start, worldInverseDir, tmin, tmax))
+            continue;
+
+        const Bvh* bvh = itr->bvh.get();
+
+        // building it here would hold up every pick queued behind this one
+        if(!bvh->built)
+        {
+            result.ready = false;
+            continue;
+        }
+
+        if(bvh->nodes.empty())
+            continue;
+
+        // the matrices are affine, the segment parameter is the same in local coordinates
+        osg::Vec3d start = request.start * itr->worldToLocal;
+        osg::Vec3d dir = request.end * itr->worldToLocal - start;
+        osg::Vec3d inverseDir = inverseDirection(dir);
+
+        stack.clear();
+        stack.push_back(0);
+
+        while(!stack.empty())
+        {
+            const BvhNode& node = bvh->nodes[stack.back()];
+            stack.pop_back();
+
+            tmin = 0.0;
+            tmax = std::min(1.0, nearest);
+
+            if(!intersectBox(node.bb, start, inverseDir, tmin, tmax))
+                continue;
+
+            if(node.count == 0)
+            {
+                stack.push_back(node.first);
+                stack.push_back(node.first + 1);
+                continue;
+            }
+
+            for(unsigned int i = node.first; i < node.first + node.count; ++i)
+            {
+                const Triangle& triangle = bvh->triangles[i];
+                double t;
+
+                if(intersectTriangle(start, dir, triangle.v0, triangle.v1, triangle.v2, t)
+                   && t >= 0.0 && t <= 1.0 && t < nearest)
+                {
+                    nearest = t;
+                    nearestEntry = &(*itr);
+                    nearestTriangle = triangle;
+                }
+            }
+        }
+    }
+
+    if(!nearestEntry)
+        return result;
+
+    osg::Vec3d normal = (nearestTriangle.v1 - nearestTriangle.v0) ^
+                        (nearestTriangle.v2 - nearestTriangle.v0);
+
+    result.valid = true;
+    result.nodePath = nearestEntry->nodePath;
+    result.geometry = nearestEntry->geometry;
+    result.primitiveIndex = nearestTriangle.index;
+    result.worldIntersectPoint = request.start + worldDir * nearest;
+    result.worldIntersectNormal = osg::Matrixd::transform3x3(nearestEntry->worldToLocal, normal);
+    result.worldIntersectNormal.normalize();
+
+    return result;
+}
@@ -0,0 +1,317 @@
+#include <osgQOpenGL/ProgramBinaryCache>
+
+#include <osg/GLExtensions>
+#include <osg/Notify>
+#include <osg/NodeVisitor>
+#include <osg/Timer>
+#include <osgDB/FileNameUtils>
+#include <osgDB/FileUtils>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+    const char MAGIC[4] = { 'O', 'Q', 'P', 'B' };
+    const unsigned int VERSION = 1;
+
+    // FNV-1a, stable across runs and builds unlike std::hash
+    unsigned long long hashBytes(unsigned long long hash, const void* data, std::size_t size)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+        for(std::size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+
+        return hash;
+    }
+
+    unsigned long long hashString(unsigned long long hash, const std::string& text)
+    {
+        // the terminator separates consecutive strings
+        return hashBytes(hash, text.c_str(), text.size() + 1);
+    }
+
+    std::string glString(GLenum name)
+    {
+        const GLubyte* value = glGetString(name);
+        return value ? reinterpret_cast<const char*>(value) : "";
+    }
+}
+
+class ProgramBinaryCache::CollectVisitor : public osg::NodeVisitor
+{
+public:
+    CollectVisitor(EntryMap& entries) :
+        osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
+        _entries(entries)
+    {
+        setNodeMaskOverride(~0u);
+    }
+
+    void apply(osg::Node& node) override
+    {
+        applyStateSet(node.getStateSet());
+        traverse(node);
+    }
+
+    void apply(osg::Drawable& drawable) override
+    {
+        applyStateSet(drawable.getStateSet());
+    }
+
+protected:
+    void applyStateSet(osg::StateSet* stateSet)
+    {
+        osg::Program* program = stateSet ?
+                                dynamic_cast<osg::Program*>(stateSet->getAttribute(osg::StateAttribute::PROGRAM)) : 0;
+
+        if(!program || program->isFixedFunction() || !program->getShaderDefines().empty())
+            return;
+
+        Entry& entry = _entries[program];
+
+        // a new program at the address of a deleted one
+        if(entry.program != program)
+        {
+            entry = Entry();
+            entry.program = program;
+        }
+    }
+
+    EntryMap& _entries;
+};
+
+ProgramBinaryCache::ProgramBinaryCache() :
+    _initialized(false),
+    _supported(false),
+    _driverHash(14695981039346656037ull)
+{
+}
+
+bool ProgramBinaryCache::initialize(osg::State& state)
+{
+    if(_initialized)
+        return _supported;
+
+    _initialized = true;
+    _supported = osg::isGLExtensionOrVersionSupported(state.getContextID(), "GL_ARB_get_program_binary", 4.1f);
+
+    // binaries are only valid for the driver that produced them
+    _driverHash = hashString(_driverHash, glString(GL_VENDOR));
+    _driverHash = hashString(_driverHash, glString(GL_RENDERER));
+    _driverHash = hashString(_driverHash, glString(GL_VERSION));
+
+    if(_supported && !_directory.empty() && !osgDB::makeDirectory(_directory))
+    {
+        OSG_WARN << "ProgramBinaryCache: cannot create " << _directory << std::endl;
+        _supported = false;
+    }
+
+    return _supported;
+}
+
+void ProgramBinaryCache::update(osg::State& state, osg::Node* scene, bool rescan)
+{
+    if(_directory.empty() || !initialize(state))
+        return;
+
+    if(rescan)
+        _subgraphs.clear();
+
+    if((rescan && scene) || !_subgraphs.empty())
+    {
+        for(EntryMap::iterator itr = _entries.begin(); itr != _entries.end();)
+        {
+            if(!itr->second.program.valid())
+                _entries.erase(itr++);
+            else
+                ++itr;
+        }
+
+        CollectVisitor visitor(_entries);
+
+        if(rescan && scene)
+            scene->accept(visitor);
+
+        for(SubgraphList::iterator itr = _subgraphs.begin(); itr != _subgraphs.end(); ++itr)
+        {
+            osg::ref_ptr<osg::Node> subgraph;
+
+            if(itr->lock(subgraph))
+                subgraph->accept(visitor);
+        }
+
+        _subgraphs.clear();
+    }
+
+    for(EntryMap::iterator itr = _entries.begin(); itr != _entries.end(); ++itr)
+    {
+        osg::ref_ptr<osg::Program> program;
+
+        if(!itr->second.prepared && itr->second.program.lock(program))
+        {
+            itr->second.prepared = true;
+            prepare(state, program.get());
+        }
+    }
+}
+
+std::string ProgramBinaryCache::getFileName(const osg::Program* program) const
+{
+    unsigned long long hash = _driverHash;
+
+    for(unsigned int i = 0; i < program->getNumShaders(); ++i)
+    {
+        const osg::Shader* shader = program->getShader(i);
+        unsigned int type = shader->getType();
+        hash = hashBytes(hash, &type, sizeof(type));
+        hash = hashString(hash, shader->getShaderSource());
+    }
+
+    const osg::Program::AttribBindingList& attribBindings = program->getAttribBindingList();
+
+    for(osg::Program::AttribBindingList::const_iterator itr = attribBindings.begin();
+        itr != attribBindings.end();
+        ++itr)
+    {
+        hash = hashString(hash, itr->first);
+        hash = hashBytes(hash, &itr->second, sizeof(itr->second));
+    }
+
+    const osg::Program::FragDataBindingList& fragDataBindings = program->getFragDataBindingList();
+
+    for(osg::Program::FragDataBindingList::const_iterator itr = fragDataBindings.begin();
+        itr != fragDataBindings.end();
+        ++itr)
+    {
+        hash = hashString(hash, itr->first);
+        hash = hashBytes(hash, &itr->second, sizeof(itr->second));
+    }
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", hash);
+
+    return osgDB::concatPaths(_directory, name);
+}
+
+void ProgramBinaryCache::prepare(osg::State& state, osg::Program* program)
+{
+    osg::Program::PerContextProgram* pcp = program->getPCP(state);
+    std::string fileName = getFileName(program);
+
+    // already linked from source by an earlier frame, its binary can still be kept
+    if(pcp->isLinked() && !pcp->needsLink())
+    {
+        if(!osgDB::fileExists(fileName))
+            store(state, program, fileName, 0.0);
+
+        return;
+    }
+    std::ifstream input(fileName.c_str(), std::ios::in | std::ios::binary);
+    char magic[4];
+    unsigned int version = 0;
+    GLenum format = 0;
+    double compileTime = 0.0;
+    unsigned int size = 0;
+
+    if(input.read(magic, sizeof(magic))
+       && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0
+       && input.read(reinterpret_cast<char*>(&version), sizeof(version))
+       && version == VERSION
+       && input.read(reinterpret_cast<char*>(&format), sizeof(format))
+       && input.read(reinterpret_cast<char*>(&compileTime), sizeof(compileTime))
+       && input.read(reinterpret_cast<char*>(&size), sizeof(size))
+       && size > 0)
+    {
+        osg::ref_ptr<osg::ProgramBinary> binary = new osg::ProgramBinary;
+        binary->allocate(size);
+
+        if(input.read(reinterpret_cast<char*>(binary->getData()), size))
+        {
+            binary->setFormat(format);
+            input.close();
+
+            double loadTime = link(state, program, binary.get());
+
+            if(program->getPCP(state)->isLinked())
+            {
+                ++_stats.numHits;
+                _stats.loadTime += loadTime;
+                _stats.savedTime += std::max(compileTime - loadTime, 0.0);
+                return;
+            }
+
+            // e.g. a driver update that kept its version string; start over from the sources
+            ++_stats.numRejected;
+            program->releaseGLObjects(&state);
+        }
+    }
+
+    input.close();
+
+    ++_stats.numMisses;
+    compileTime = compile(state, program);
+    _stats.compileTime += compileTime;
+
+    if(program->getPCP(state)->isLinked())
+        store(state, program, fileName, compileTime);
+}
+
+double ProgramBinaryCache::compile(osg::State& state, osg::Program* program)
+{
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+    program->compileGLObjects(state);
+
+    // querying the link status waits for the driver to complete the link
+    GLint linked = GL_FALSE;
+    state.get<osg::GLExtensions>()->glGetProgramiv(program->getPCP(state)->getHandle(), GL_LINK_STATUS, &linked);
+
+    return osg::Timer::instance()->delta_s(startTick, osg::Timer::instance()->tick());
+}
+
+double ProgramBinaryCache::link(osg::State& state, osg::Program* program, osg::ProgramBinary* binary)
+{
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+
+    // link the binary in place of the shaders, which are attached but never compiled
+    // unlike with Program::compileGLObjects(). The program keeps the binary only for
+    // the link, a later relink, e.g. in another context, starts from the sources.
+    program->setProgramBinary(binary);
+    osg::Program::PerContextProgram* pcp = program->getPCP(state);
+    pcp->requestLink();
+    pcp->linkProgram(state);
+    program->setProgramBinary(0);
+
+    return osg::Timer::instance()->delta_s(startTick, osg::Timer::instance()->tick());
+}
+
+void ProgramBinaryCache::store(osg::State& state, osg::Program* program, const std::string& fileName,
+                               double compileTime)
+{
+    osg::ref_ptr<osg::ProgramBinary> binary = program->getPCP(state)->compileProgramBinary(state);
+
+    if(!binary.valid() || binary->getSize() == 0)
+        return;
+
+    std::ofstream output(fileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    GLenum format = binary->getFormat();
+    unsigned int size = binary->getSize();
+
+    output.write(MAGIC, sizeof(MAGIC));
+    output.write(reinterpret_cast<const char*>(&VERSION), sizeof(VERSION));
+    output.write(reinterpret_cast<const char*>(&format), sizeof(format));
+    output.write(reinterpret_cast<const char*>(&compileTime), sizeof(compileTime));
+    output.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    output.write(reinterpret_cast<const char*>(binary->getData()), size);
+
+    if(output)
+        ++_stats.numStored;
+    else
+        OSG_WARN << "ProgramBinaryCache: cannot write " << fileName << std::endl;
+}
@@ -0,0 +1,283 @@
+#include <osgQOpenGL/ProgressiveRefiner>
+#include <osgQOpenGL/FrameTracer>
+
+#include <osg/BlendFunc>
+#include <osg/GLExtensions>
+#include <osg/GraphicsContext>
+#include <osg/Program>
+
+#include <algorithm>
+
+#ifndef GL_RGBA16F_ARB
+#define GL_RGBA16F_ARB 0x881A
+#endif
+
+#ifndef GL_DEPTH24_STENCIL8_EXT
+#define GL_DEPTH24_STENCIL8_EXT 0x88F0
+#endif
+
+namespace
+{
+    // a triangle covering the viewport, positions in clip space
+    const char* REFINE_VERTEX_SHADER =
+        "#version 130\n"
+        "void main()\n"
+        "{\n"
+        "    gl_Position = vec4(gl_Vertex.xy, 0.0, 1.0);\n"
+        "}\n";
+
+    // the alpha is the weight of the blend into the accumulation texture
+    const char* REFINE_FRAGMENT_SHADER =
+        "#version 130\n"
+        "uniform sampler2D refineInput;\n"
+        "uniform vec2 refineInverseSize;\n"
+        "uniform float refineWeight;\n"
+        "out vec4 fragColor;\n"
+        "void main()\n"
+        "{\n"
+        "    fragColor = vec4(texture(refineInput, gl_FragCoord.xy * refineInverseSize).rgb, refineWeight);\n"
+        "}\n";
+
+    double halton(unsigned int index, unsigned int base)
+    {
+        double result = 0.0;
+        double f = 1.0;
+
+        while(index > 0)
+        {
+            f /= base;
+            result += f * (index % base);
+            index /= base;
+        }
+
+        return result;
+    }
+
+    osg::Texture2D* createTexture(GLint internalFormat, GLenum sourceType)
+    {
+        osg::Texture2D* texture = new osg::Texture2D();
+        texture->setTextureSize(1, 1);
+        texture->setInternalFormat(internalFormat);
+        texture->setSourceFormat(GL_RGBA);
+        texture->setSourceType(sourceType);
+        texture->setResizeNonPowerOfTwoHint(false);
+        texture->setFilter(osg::Texture::MIN_FILTER, osg::Texture::NEAREST);
+        texture->setFilter(osg::Texture::MAG_FILTER, osg::Texture::NEAREST);
+        texture->setWrap(osg::Texture::WRAP_S, osg::Texture::CLAMP_TO_EDGE);
+        texture->setWrap(osg::Texture::WRAP_T, osg::Texture::CLAMP_TO_EDGE);
+        return texture;
+    }
+}
+
+ProgressiveRefiner::ProgressiveRefiner() :
+    _idleDelay(0.3),
+    _numSamples(16),
+    _interactiveLODScale(2.0f),
+    _interactiveSmallFeatureCullingPixelSize(4.0f),
+    _lastInputTick(0),
+    _numAccumulated(0),
+    _sceneModifiedCount(0),
+    _jittering(false),
+    _presenting(false),
+    _width(0),
+    _height(0)
+{
+    _frameTexture = createTexture(GL_RGBA8, GL_UNSIGNED_BYTE);
+    _accumTexture = createTexture(GL_RGBA16F_ARB, GL_FLOAT);
+    _frameFbo = new osg::FrameBufferObject();
+    _accumFbo = new osg::FrameBufferObject();
+
+    osg::Vec3Array* vertices = new osg::Vec3Array();
+    vertices->push_back(osg::Vec3(-1.0f, -1.0f, 0.0f));
+    vertices->push_back(osg::Vec3(3.0f, -1.0f, 0.0f));
+    vertices->push_back(osg::Vec3(-1.0f, 3.0f, 0.0f));
+
+    _geometry = new osg::Geometry();
+    _geometry->setName("ProgressiveRefiner");
+    _geometry->setUseDisplayList(false);
+    _geometry->setUseVertexBufferObjects(true);
+    _geometry->setVertexArray(vertices);
+    _geometry->addPrimitiveSet(new osg::DrawArrays(GL_TRIANGLES, 0, 3));
+
+    osg::Program* program = new osg::Program();
+    program->setName("ProgressiveRefiner");
+    program->addShader(new osg::Shader(osg::Shader::VERTEX, REFINE_VERTEX_SHADER));
+    program->addShader(new osg::Shader(osg::Shader::FRAGMENT, REFINE_FRAGMENT_SHADER));
+
+    _inverseSize = new osg::Uniform("refineInverseSize", osg::Vec2(1.0f, 1.0f));
+    _weight = new osg::Uniform("refineWeight", 1.0f);
+
+    // the state left by the last leaf of the stage must not reach the copies
+    const unsigned int on = osg::StateAttribute::ON | osg::StateAttribute::OVERRIDE |
+                            osg::StateAttribute::PROTECTED;
+    const unsigned int off = osg::StateAttribute::OFF | osg::StateAttribute::OVERRIDE |
+                             osg::StateAttribute::PROTECTED;
+
+    _accumulateStateSet = new osg::StateSet();
+    _accumulateStateSet->setAttributeAndModes(program, on);
+    _accumulateStateSet->setTextureAttributeAndModes(0, _frameTexture.get(), on);
+    _accumulateStateSet->addUniform(new osg::Uniform("refineInput", 0));
+    _accumulateStateSet->addUniform(_inverseSize.get());
+    _accumulateStateSet->addUniform(_weight.get());
+    // average += weight * (frame - average)
+    _accumulateStateSet->setAttributeAndModes(new osg::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA,
+                                                                 GL_ONE, GL_ZERO), on);
+    _accumulateStateSet->setMode(GL_DEPTH_TEST, off);
+    _accumulateStateSet->setMode(GL_CULL_FACE, off);
+    _accumulateStateSet->setMode(GL_STENCIL_TEST, off);
+
+    _presentStateSet = new osg::StateSet();
+    _presentStateSet->setAttributeAndModes(program, on);
+    _presentStateSet->setTextureAttributeAndModes(0, _accumTexture.get(), on);
+    _presentStateSet->addUniform(new osg::Uniform("refineInput", 0));
+    _presentStateSet->addUniform(_inverseSize.get());
+    _presentStateSet->addUniform(new osg::Uniform("refineWeight", 1.0f));
+    _presentStateSet->setMode(GL_BLEND, off);
+    _presentStateSet->setMode(GL_DEPTH_TEST, off);
+    _presentStateSet->setMode(GL_CULL_FACE, off);
+    _presentStateSet->setMode(GL_STENCIL_TEST, off);
+
+    resize(1, 1);
+}
+
+ProgressiveRefiner::~ProgressiveRefiner()
+{
+}
+
+bool ProgressiveRefiner::isInteracting() const
+{
+    return _lastInputTick &&
+           osg::Timer::instance()->delta_s(_lastInputTick, osg::Timer::instance()->tick()) < _idleDelay;
+}
+
+void ProgressiveRefiner::resize(int width, int height)
+{
+    width = std::max(width, 1);
+    height = std::max(height, 1);
+
+    if(width == _width && height == _height)
+        return;
+
+    _width = width;
+    _height = height;
+    restart();
+
+    _frameTexture->setTextureSize(width, height);
+    _frameTexture->dirtyTextureObject();
+    _accumTexture->setTextureSize(width, height);
+    _accumTexture->dirtyTextureObject();
+
+    // setting the attachments again makes the objects rebuild them
+    _frameFbo->setAttachment(osg::Camera::COLOR_BUFFER0, osg::FrameBufferAttachment(_frameTexture.get()));
+    _frameFbo->setAttachment(osg::Camera::PACKED_DEPTH_STENCIL_BUFFER,
+                             osg::FrameBufferAttachment(new osg::RenderBuffer(width, height,
+                                                                              GL_DEPTH24_STENCIL8_EXT)));
+    _accumFbo->setAttachment(osg::Camera::COLOR_BUFFER0, osg::FrameBufferAttachment(_accumTexture.get()));
+
+    _inverseSize->set(osg::Vec2(1.0f / width, 1.0f / height));
+
+    // present() is called outside of any stage, a new object makes the state apply it
+    _presentStateSet->setAttribute(new osg::Viewport(0, 0, width, height),
+                                   osg::StateAttribute::OVERRIDE | osg::StateAttribute::PROTECTED);
+}
+
+osg::Matrixd ProgressiveRefiner::jitter(const osg::Matrixd& projection) const
+{
+    // the first sample is not offset, so that the first image matches the interactive ones
+    if(_numAccumulated == 0)
+        return projection;
+
+    double x = halton(_numAccumulated, 2) - 0.5;
+    double y = halton(_numAccumulated, 3) - 0.5;
+    return projection * osg::Matrixd::translate(2.0 * x / _width, 2.0 * y / _height, 0.0);
+}
+
+void ProgressiveRefiner::beginFrame(osg::Camera& camera, unsigned int sceneModifiedCount)
+{
+    if(_view != camera.getViewMatrix()
+       || _projection != camera.getProjectionMatrix()
+       || _sceneModifiedCount != sceneModifiedCount)
+    {
+        _view = camera.getViewMatrix();
+        _projection = camera.getProjectionMatrix();
+        _sceneModifiedCount = sceneModifiedCount;
+        restart();
+    }
+
+    if(isConverged())
+    {
+        _presenting = true;
+    }
+    else
+    {
+        camera.setProjectionMatrix(jitter(_projection));
+        _jittering = true;
+    }
+}
+
+void ProgressiveRefiner::endFrame(osg::Camera& camera)
+{
+    // the manipulator sets the view matrix only, the jitter is applied again next frame
+    if(_jittering)
+        camera.setProjectionMatrix(_projection);
+
+    _jittering = false;
+    _presenting = false;
+}
+
+void ProgressiveRefiner::bindDefaultFramebuffer(osg::State& state)
+{
+    GLuint defaultFbo = state.getGraphicsContext() ? state.getGraphicsContext()->getDefaultFboId() : 0;
+    state.get<osg::GLExtensions>()->glBindFramebuffer(GL_FRAMEBUFFER_EXT, defaultFbo);
+}
+
+void ProgressiveRefiner::draw(osg::RenderInfo& renderInfo, osg::StateSet* stateSet)
+{
+    osg::State& state = *renderInfo.getState();
+    state.pushStateSet(stateSet);
+    state.apply();
+    _geometry->draw(renderInfo);
+    state.popStateSet();
+    state.apply();
+}
+
+void ProgressiveRefiner::present(osg::RenderInfo& renderInfo)
+{
+    osg::State& state = *renderInfo.getState();
+
+    if(!state.get<osg::GLExtensions>()->isFrameBufferObjectSupported)
+        return;
+
+    OSGQOPENGL_TRACE_ZONE("refinement present");
+    bindDefaultFramebuffer(state);
+    draw(renderInfo, _presentStateSet.get());
+}
+
+void ProgressiveRefiner::operator()(osg::RenderInfo& renderInfo, RenderStageEx& stage)
+{
+    if(stage.getFrameBufferObject() != _frameFbo.get())
+        return;
+
+    osg::State& state = *renderInfo.getState();
+
+    if(!state.get<osg::GLExtensions>()->isFrameBufferObjectSupported)
+        return;
+
+    OSGQOPENGL_TRACE_ZONE("refinement accumulate");
+
+    // the first frame replaces the previous image
+    _weight->set(1.0f / (_numAccumulated + 1));
+    _accumFbo->apply(state);
+    draw(renderInfo, _accumulateStateSet.get());
+    ++_numAccumulated;
+
+    bindDefaultFramebuffer(state);
+    draw(renderInfo, _presentStateSet.get());
+}
+
+void ProgressiveRefiner::reportStats(osg::Stats& stats, unsigned int frameNumber) const
+{
+    stats.setAttribute(frameNumber, "Refinement interacting", isInteracting() ? 1.0 : 0.0);
+    stats.setAttribute(frameNumber, "Refinement accumulated frames", _numAccumulated);
+    stats.setAttribute(frameNumber, "Refinement presented", _presenting ? 1.0 : 0.0);
+}
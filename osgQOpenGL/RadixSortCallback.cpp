@@ -0,0 +1,338 @@
+#include <osgQOpenGL/RadixSortCallback>
+
+#include <osgUtil/StateGraph>
+#include <osg/Math>
+#include <osg/Timer>
+
+#include <algorithm>
+#include <cfloat>
+
+namespace
+{
+    const unsigned int DEPTH_BITS = 20;
+    const unsigned int STATE_BITS = 32 - DEPTH_BITS;
+    const unsigned int DEPTH_MAX = (1u << DEPTH_BITS) - 1;
+    const unsigned int STATE_MAX = (1u << STATE_BITS) - 1;
+
+    const unsigned int RADIX_BITS = 11;
+    const unsigned int RADIX_SIZE = 1u << RADIX_BITS;
+    const unsigned int RADIX_PASSES = (32 + RADIX_BITS - 1) / RADIX_BITS;
+
+    unsigned int quantize(float value, float minValue, float scale)
+    {
+        float q = (value - minValue) * scale;
+        return q <= 0.0f ? 0u : (q >= static_cast<float>(DEPTH_MAX) ? DEPTH_MAX :
+                                 static_cast<unsigned int>(q));
+    }
+
+    // the comparisons of RenderBin::sortImpl(), used to measure the stock sort.
+    struct LeafFrontToBack
+    {
+        bool operator()(const osgUtil::RenderLeaf* lhs, const osgUtil::RenderLeaf* rhs) const
+        {
+            return lhs->_depth < rhs->_depth;
+        }
+    };
+
+    struct LeafBackToFront
+    {
+        bool operator()(const osgUtil::RenderLeaf* lhs, const osgUtil::RenderLeaf* rhs) const
+        {
+            return rhs->_depth < lhs->_depth;
+        }
+    };
+
+    struct StateGraphFrontToBack
+    {
+        bool operator()(const osgUtil::StateGraph* lhs, const osgUtil::StateGraph* rhs) const
+        {
+            return lhs->_minimumDistance < rhs->_minimumDistance;
+        }
+    };
+}
+
+RadixSortCallback::RadixSortCallback() :
+    _threshold(256),
+    _measureStockSort(false)
+{
+}
+
+void RadixSortCallback::reportStats(osg::Stats& stats, unsigned int frameNumber) const
+{
+    stats.setAttribute(frameNumber, "Sort stock bins", _stats.numStockSorts);
+    stats.setAttribute(frameNumber, "Sort stock leaves", _stats.numStockLeaves);
+    stats.setAttribute(frameNumber, "Sort stock time taken", _stats.stockSortTime);
+    stats.setAttribute(frameNumber, "Sort radix bins", _stats.numRadixSorts);
+    stats.setAttribute(frameNumber, "Sort radix leaves", _stats.numRadixLeaves);
+    stats.setAttribute(frameNumber, "Sort radix time taken", _stats.radixSortTime);
+
+    if(getMeasureStockSort())
+        stats.setAttribute(frameNumber, "Sort reference time taken", _stats.referenceSortTime);
+}
+
+void RadixSortCallback::sortImplementation(osgUtil::RenderBin* bin)
+{
+    osgUtil::RenderBin::SortMode mode = bin->getSortMode();
+    bool radixMode = mode == osgUtil::RenderBin::SORT_FRONT_TO_BACK
+                     || mode == osgUtil::RenderBin::SORT_BACK_TO_FRONT
+                     || mode == osgUtil::RenderBin::SORT_BY_STATE_THEN_FRONT_TO_BACK;
+
+    unsigned int numLeaves = bin->getRenderLeafList().size();
+
+    for(osgUtil::RenderBin::StateGraphList::const_iterator itr = bin->getStateGraphList().begin();
+        itr != bin->getStateGraphList().end();
+        ++itr)
+    {
+        numLeaves += (*itr)->_leaves.size();
+    }
+
+    // before the radix sort, which changes the order of the bin.
+    if(_measureStockSort && radixMode && numLeaves >= _threshold)
+        measureStockSort(bin);
+
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+
+    if(!radixMode || numLeaves < _threshold)
+    {
+        bin->sortImpl();
+
+        ++_stats.numStockSorts;
+        _stats.numStockLeaves += numLeaves;
+        _stats.stockSortTime += osg::Timer::instance()->delta_s(startTick,
+                                                                osg::Timer::instance()->tick());
+        return;
+    }
+
+    if(mode == osgUtil::RenderBin::SORT_BY_STATE_THEN_FRONT_TO_BACK)
+        sortStateGraphsByDepth(bin);
+    else
+        sortLeavesByDepth(bin, mode == osgUtil::RenderBin::SORT_BACK_TO_FRONT);
+
+    ++_stats.numRadixSorts;
+    _stats.numRadixLeaves += numLeaves;
+    _stats.radixSortTime += osg::Timer::instance()->delta_s(startTick,
+                                                            osg::Timer::instance()->tick());
+}
+
+void RadixSortCallback::sortLeavesByDepth(osgUtil::RenderBin* bin, bool backToFront)
+{
+    // gather the leaves like RenderBin::copyLeavesFromStateGraphListToRenderLeafList(),
+    // numbering the state graphs on the way.
+    _leaves.clear();
+    _stateGraphIds.clear();
+
+    osgUtil::RenderBin::StateGraphList& stateGraphs = bin->getStateGraphList();
+    unsigned int stateGraphId = 0;
+
+    for(osgUtil::RenderBin::StateGraphList::iterator itr = stateGraphs.begin();
+        itr != stateGraphs.end();
+        ++itr, ++stateGraphId)
+    {
+        for(osgUtil::StateGraph::LeafList::iterator litr = (*itr)->_leaves.begin();
+            litr != (*itr)->_leaves.end();
+            ++litr)
+        {
+            if(!osg::isNaN((*litr)->_depth))
+            {
+                _leaves.push_back(litr->get());
+                _stateGraphIds.push_back(std::min(stateGraphId, STATE_MAX));
+            }
+        }
+    }
+
+    // leaves already moved to the leaf list keep the id following the state graphs.
+    osgUtil::RenderBin::RenderLeafList& leafList = bin->getRenderLeafList();
+
+    for(osgUtil::RenderBin::RenderLeafList::iterator itr = leafList.begin();
+        itr != leafList.end();
+        ++itr)
+    {
+        if(!osg::isNaN((*itr)->_depth))
+        {
+            _leaves.push_back(*itr);
+            _stateGraphIds.push_back(std::min(stateGraphId, STATE_MAX));
+        }
+    }
+
+    float minDepth = FLT_MAX;
+    float maxDepth = -FLT_MAX;
+
+    for(std::vector<osgUtil::RenderLeaf*>::const_iterator itr = _leaves.begin();
+        itr != _leaves.end();
+        ++itr)
+    {
+        minDepth = std::min(minDepth, (*itr)->_depth);
+        maxDepth = std::max(maxDepth, (*itr)->_depth);
+    }
+
+    float scale = maxDepth > minDepth ? static_cast<float>(DEPTH_MAX) / (maxDepth - minDepth) :
+                  0.0f;
+
+    _items.resize(_leaves.size());
+
+    for(std::size_t i = 0; i < _leaves.size(); ++i)
+    {
+        unsigned int depth = quantize(_leaves[i]->_depth, minDepth, scale);
+
+        if(backToFront)
+            depth = DEPTH_MAX - depth;
+
+        unsigned long long key = (depth << STATE_BITS) | _stateGraphIds[i];
+        _items[i] = (key << 32) | i;
+    }
+
+    radixSort();
+
+    // the list holds raw pointers, the leaves are kept alive by their state graphs.
+    leafList.clear();
+    leafList.reserve(_items.size());
+
+    for(std::size_t i = 0; i < _items.size(); ++i)
+    {
+        leafList.push_back(_leaves[static_cast<unsigned int>(_items[i] & 0xffffffffull)]);
+    }
+
+    // the leaf list is drawn instead of the state graph list, see RenderBin::drawImplementation().
+    stateGraphs.clear();
+}
+
+void RadixSortCallback::sortStateGraphsByDepth(osgUtil::RenderBin* bin)
+{
+    osgUtil::RenderBin::StateGraphList& stateGraphs = bin->getStateGraphList();
+
+    float minDepth = FLT_MAX;
+    float maxDepth = -FLT_MAX;
+
+    for(osgUtil::RenderBin::StateGraphList::iterator itr = stateGraphs.begin();
+        itr != stateGraphs.end();
+        ++itr)
+    {
+        (*itr)->sortFrontToBack();
+        float depth = (*itr)->getMinimumDistance();
+        minDepth = std::min(minDepth, depth);
+        maxDepth = std::max(maxDepth, depth);
+    }
+
+    float scale = maxDepth > minDepth ? static_cast<float>(DEPTH_MAX) / (maxDepth - minDepth) :
+                  0.0f;
+
+    _items.resize(stateGraphs.size());
+
+    for(std::size_t i = 0; i < stateGraphs.size(); ++i)
+    {
+        unsigned long long key = quantize(stateGraphs[i]->getMinimumDistance(), minDepth,
+                                          scale) << STATE_BITS;
+        _items[i] = (key << 32) | i;
+    }
+
+    radixSort();
+
+    std::vector<osgUtil::StateGraph*> sorted(stateGraphs.size());
+
+    for(std::size_t i = 0; i < _items.size(); ++i)
+    {
+        sorted[i] = stateGraphs[static_cast<unsigned int>(_items[i] & 0xffffffffull)];
+    }
+
+    stateGraphs.swap(sorted);
+}
+
+void RadixSortCallback::measureStockSort(osgUtil::RenderBin* bin)
+{
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+
+    osgUtil::RenderBin::StateGraphList& stateGraphs = bin->getStateGraphList();
+
+    // same work as RenderBin::sortImpl() for these modes, done on copies of the lists.
+    if(bin->getSortMode() == osgUtil::RenderBin::SORT_BY_STATE_THEN_FRONT_TO_BACK)
+    {
+        _referenceStateGraphs.assign(stateGraphs.begin(), stateGraphs.end());
+
+        for(std::vector<osgUtil::StateGraph*>::iterator itr = _referenceStateGraphs.begin();
+            itr != _referenceStateGraphs.end();
+            ++itr)
+        {
+            (*itr)->sortFrontToBack();
+            (*itr)->getMinimumDistance();
+        }
+
+        std::sort(_referenceStateGraphs.begin(), _referenceStateGraphs.end(),
+                  StateGraphFrontToBack());
+    }
+    else
+    {
+        _referenceLeaves.clear();
+
+        for(osgUtil::RenderBin::StateGraphList::iterator itr = stateGraphs.begin();
+            itr != stateGraphs.end();
+            ++itr)
+        {
+            for(osgUtil::StateGraph::LeafList::iterator litr = (*itr)->_leaves.begin();
+                litr != (*itr)->_leaves.end();
+                ++litr)
+            {
+                if(!osg::isNaN((*litr)->_depth))
+                    _referenceLeaves.push_back(litr->get());
+            }
+        }
+
+        for(osgUtil::RenderBin::RenderLeafList::iterator itr = bin->getRenderLeafList().begin();
+            itr != bin->getRenderLeafList().end();
+            ++itr)
+        {
+            if(!osg::isNaN((*itr)->_depth))
+                _referenceLeaves.push_back(*itr);
+        }
+
+        if(bin->getSortMode() == osgUtil::RenderBin::SORT_BACK_TO_FRONT)
+            std::sort(_referenceLeaves.begin(), _referenceLeaves.end(), LeafBackToFront());
+        else
+            std::sort(_referenceLeaves.begin(), _referenceLeaves.end(), LeafFrontToBack());
+    }
+
+    _stats.referenceSortTime += osg::Timer::instance()->delta_s(startTick,
+                                                                osg::Timer::instance()->tick());
+}
+
+void RadixSortCallback::radixSort()
+{
+    // NaN depth leaves are left out, so there may be nothing left to order.
+    if(_items.size() < 2)
+        return;
+
+    _scratch.resize(_items.size());
+
+    unsigned int counts[RADIX_SIZE];
+
+    for(unsigned int pass = 0; pass < RADIX_PASSES; ++pass)
+    {
+        const unsigned int shift = 32 + pass * RADIX_BITS;
+
+        std::fill(counts, counts + RADIX_SIZE, 0u);
+
+        for(std::size_t i = 0; i < _items.size(); ++i)
+        {
+            ++counts[(_items[i] >> shift) & (RADIX_SIZE - 1)];
+        }
+
+        // a pass where every key has the same digit leaves the order unchanged.
+        if(counts[(_items[0] >> shift) & (RADIX_SIZE - 1)] == _items.size())
+            continue;
+
+        unsigned int offset = 0;
+
+        for(unsigned int i = 0; i < RADIX_SIZE; ++i)
+        {
+            unsigned int count = counts[i];
+            counts[i] = offset;
+            offset += count;
+        }
+
+        for(std::size_t i = 0; i < _items.size(); ++i)
+        {
+            _scratch[counts[(_items[i] >> shift) & (RADIX_SIZE - 1)]++] = _items[i];
+        }
+
+        _items.swap(_scratch);
+    }
+}
@@ -1,5 +1,201 @@
 #include <osgQOpenGL/RenderStageEx>
 #include <osgQOpenGL/StateEx>
+#include <osgQOpenGL/FrameTracer>
+
+#include <osgUtil/StateGraph>
+
+RenderStageEx::RenderStageEx() :
+    osgUtil::RenderStage(),
+    _recordLeaves(false),
+    _leavesRecorded(false),
+    _contentKept(false)
+{
+}
+
+void RenderStageEx::setRecordLeaves(bool flag)
+{
+    if(_recordLeaves == flag)
+        return;
+
+    _recordLeaves = flag;
+
+    if(!_recordLeaves)
+    {
+        _recordedLeaves.clear();
+        _leavesRecorded = false;
+        _contentKept = false;
+        _keptContent = KeptContent();
+    }
+}
+
+void RenderStageEx::reset()
+{
+    if(!_recordLeaves)
+    {
+        osgUtil::RenderStage::reset();
+        return;
+    }
+
+    // the bins and stages taken out are not reset, nested stages are reset by
+    // CullVisitorEx when their camera is culled again.
+    _keptContent.stateGraphs.swap(_stateGraphList);
+    _keptContent.leaves.swap(_renderLeafList);
+    _keptContent.bins.swap(_bins);
+    _keptContent.preRenderStages.swap(_preRenderList);
+    _keptContent.postRenderStages.swap(_postRenderList);
+    _keptContent.sorted = _sorted;
+
+    if(_renderStageLighting.valid())
+    {
+        _keptContent.attributes = _renderStageLighting->getAttrMatrixList();
+        _keptContent.textureAttributes = _renderStageLighting->getTexUnitAttrMatrixListMap();
+    }
+    else
+    {
+        _keptContent.attributes.clear();
+        _keptContent.textureAttributes.clear();
+    }
+
+    _contentKept = true;
+
+    osgUtil::RenderStage::reset();
+}
+
+void RenderStageEx::setRadixSortCallback(RadixSortCallback* callback)
+{
+    _radixSortCallback = callback;
+    setSortCallback(callback);
+}
+
+void RenderStageEx::setInstanceBatcher(InstanceBatcher* batcher)
+{
+    _instanceBatcher = batcher;
+
+    if(!_instanceBatcher)
+        _instanceBatches.clear();
+}
+
+void RenderStageEx::sort()
+{
+    // a stage which is drawn again without cull is still flagged as sorted, and
+    // its recorded leaves are already up to date.
+    bool alreadySorted = _sorted;
+
+    OSGQOPENGL_TRACE_ZONE("RenderStage sort");
+
+    if(_instanceBatcher.valid() && !alreadySorted)
+    {
+        OSGQOPENGL_TRACE_ZONE("RenderStage instance batching");
+        _instanceBatcher->batch(this, _instanceBatches);
+    }
+
+    // the bins below the stage are created again by each cull traversal.
+    if(_radixSortCallback.valid() && !alreadySorted)
+        setSortCallbacks(this);
+
+    osgUtil::RenderStage::sort();
+
+    if(_recordLeaves && !alreadySorted)
+    {
+        _recordedLeaves.clear();
+        recordLeaves(this);
+        _leavesRecorded = true;
+
+        // the stage has been culled again, what reset() kept is out of date
+        _contentKept = false;
+    }
+}
+
+void RenderStageEx::recordLeaves(osgUtil::RenderBin* bin)
+{
+    for(RenderBinList::iterator itr = bin->getRenderBinList().begin();
+        itr != bin->getRenderBinList().end();
+        ++itr)
+    {
+        recordLeaves(itr->second.get());
+    }
+
+    // state sorted bins draw the leaves through their state graphs.
+    for(StateGraphList::iterator itr = bin->getStateGraphList().begin();
+        itr != bin->getStateGraphList().end();
+        ++itr)
+    {
+        osgUtil::StateGraph* sg = *itr;
+
+        for(osgUtil::StateGraph::LeafList::iterator litr = sg->_leaves.begin();
+            litr != sg->_leaves.end();
+            ++litr)
+        {
+            _recordedLeaves.push_back(RecordedLeaf(sg, *litr));
+        }
+    }
+
+    // depth sorted bins hold the leaves directly, but their state graphs still need
+    // leaves so that they are not pruned away at the end of the cull.
+    for(RenderLeafList::iterator itr = bin->getRenderLeafList().begin();
+        itr != bin->getRenderLeafList().end();
+        ++itr)
+    {
+        _recordedLeaves.push_back(RecordedLeaf((*itr)->_parent, *itr));
+    }
+}
+
+void RenderStageEx::setSortCallbacks(osgUtil::RenderBin* bin)
+{
+    bin->setSortCallback(_radixSortCallback.get());
+
+    for(RenderBinList::iterator itr = bin->getRenderBinList().begin();
+        itr != bin->getRenderBinList().end();
+        ++itr)
+    {
+        setSortCallbacks(itr->second.get());
+    }
+}
+
+void RenderStageEx::restoreLeaves()
+{
+    // a nested stage whose parent was culled again has not been reset
+    if(_contentKept)
+    {
+        _stateGraphList.swap(_keptContent.stateGraphs);
+        _renderLeafList.swap(_keptContent.leaves);
+        _bins.swap(_keptContent.bins);
+        _preRenderList.swap(_keptContent.preRenderStages);
+        _postRenderList.swap(_keptContent.postRenderStages);
+        _sorted = _keptContent.sorted;
+
+        // the lights added by SceneView since the reset are the ones of the kept content
+        getPositionalStateContainer()->getAttrMatrixList().swap(_keptContent.attributes);
+        getPositionalStateContainer()->getTexUnitAttrMatrixListMap().swap(_keptContent.textureAttributes);
+
+        _contentKept = false;
+    }
+
+    for(RecordedLeafList::iterator itr = _recordedLeaves.begin();
+        itr != _recordedLeaves.end();
+        ++itr)
+    {
+        itr->first->addLeaf(itr->second.get());
+    }
+
+    for(RenderStageList::iterator itr = _preRenderList.begin();
+        itr != _preRenderList.end();
+        ++itr)
+    {
+        RenderStageEx* stage = dynamic_cast<RenderStageEx*>(itr->second.get());
+
+        if(stage) stage->restoreLeaves();
+    }
+
+    for(RenderStageList::iterator itr = _postRenderList.begin();
+        itr != _postRenderList.end();
+        ++itr)
+    {
+        RenderStageEx* stage = dynamic_cast<RenderStageEx*>(itr->second.get());
+
+        if(stage) stage->restoreLeaves();
+    }
+}
 
 void RenderStageEx::drawInner(osg::RenderInfo& renderInfo,
                               osgUtil::RenderLeaf*& previous, bool& doCopyTexture)
@@ -274,5 +470,40 @@ void RenderStageEx::drawInner(osg::RenderInfo& renderInfo,
         }
     }
 
+#else
+    OSGQOPENGL_TRACE_ZONE("RenderStage draw");
+
+    if(_instanceBatcher.valid())
+        _instanceBatcher->resetInstanceMatrices(*renderInfo.getState());
+
+    TextureResidencyManager::HiddenLeaves hiddenLeaves;
+
+    if(_textureResidencyManager.valid())
+        _textureResidencyManager->beginDraw(*renderInfo.getState(), this, hiddenLeaves);
+
+    osgUtil::RenderStage::drawInner(renderInfo, previous, doCopyTexture);
+
+    // a stage drawn again without cull needs all of its leaves
+    if(_textureResidencyManager.valid())
+        _textureResidencyManager->endDraw(hiddenLeaves);
+
+    // render to texture stages have their own framebuffer object
+    if(_multisampleTarget.valid() && !_fbo.valid() && _viewport.valid())
+        _multisampleTarget->addDrawnRegion(*_viewport);
+
+    if(_drawCallback.valid())
+        (*_drawCallback)(renderInfo, *this);
 #endif
 }
+
+void RenderStageEx::releaseGLObjects(osg::State* state) const
+{
+    osgUtil::RenderStage::releaseGLObjects(state);
+
+    for(InstanceBatcher::BatchList::const_iterator itr = _instanceBatches.begin();
+        itr != _instanceBatches.end();
+        ++itr)
+    {
+        itr->drawable->releaseGLObjects(state);
+    }
+}
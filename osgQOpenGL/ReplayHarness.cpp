@@ -0,0 +1,64 @@
+#include <osgQOpenGL/ReplayHarness>
+#include <osgQOpenGL/OSGRenderer>
+
+#include <osgGA/TrackballManipulator>
+#include <osg/Notify>
+
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+
+ReplayHarness::ReplayHarness() :
+    _width(1280),
+    _height(720),
+    _timing(InputRecorder::FIXED_TIME)
+{
+}
+
+bool ReplayHarness::run(osg::Node* scene, const std::string& recordingFileName)
+{
+    QOpenGLContext context;
+
+    if(!context.create())
+    {
+        OSG_WARN << "ReplayHarness: can not create an OpenGL context" << std::endl;
+        return false;
+    }
+
+    QOffscreenSurface surface;
+    surface.setFormat(context.format());
+    surface.create();
+
+    if(!context.makeCurrent(&surface))
+    {
+        OSG_WARN << "ReplayHarness: can not make the OpenGL context current" << std::endl;
+        return false;
+    }
+
+    QOpenGLFramebufferObjectFormat format;
+    format.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+    QOpenGLFramebufferObject target(_width, _height, format);
+
+    // released before the target and the context
+    osg::ref_ptr<OSGRenderer> renderer = new OSGRenderer(nullptr, enOffscreen);
+    renderer->setupOSG(_width, _height, 1.0f);
+    renderer->resize(_width, _height, 1.0f);
+
+    // the manipulator is homed on the scene
+    renderer->setSceneData(scene);
+    renderer->setCameraManipulator(_cameraManipulator.valid() ? _cameraManipulator.get() :
+                                   new osgGA::TrackballManipulator());
+
+    if(!renderer->startInputReplay(QString::fromLocal8Bit(recordingFileName.c_str()), _timing))
+        return false;
+
+    _inputRecorder = renderer->inputRecorder();
+
+    while(renderer->inputReplaying())
+    {
+        renderer->setDefaultFramebuffer(target.handle());
+        renderer->frame();
+    }
+
+    return true;
+}
@@ -0,0 +1,95 @@
+#include <osgQOpenGL/SceneCommandQueue>
+
+#include <osg/Timer>
+
+#include <algorithm>
+
+SceneCommandQueue::SceneCommandQueue() :
+    _head(nullptr),
+    _numPushed(0)
+{
+}
+
+SceneCommandQueue::~SceneCommandQueue()
+{
+    Node* node = _head.exchange(nullptr);
+
+    while(node)
+    {
+        Node* next = node->next;
+        delete node;
+        node = next;
+    }
+}
+
+void SceneCommandQueue::push(Command command)
+{
+    Node* node = new Node;
+    node->command = std::move(command);
+    node->next = _head.load(std::memory_order_relaxed);
+
+    while(!_head.compare_exchange_weak(node->next, node,
+                                       std::memory_order_release, std::memory_order_relaxed))
+    {
+    }
+
+    _numPushed.fetch_add(1, std::memory_order_relaxed);
+}
+
+unsigned int SceneCommandQueue::swap()
+{
+    Node* node = _head.exchange(nullptr, std::memory_order_acquire);
+
+    // the stack holds the latest push first
+    std::size_t first = _batch.size();
+
+    while(node)
+    {
+        Node* next = node->next;
+        _batch.push_back(std::move(node->command));
+        delete node;
+        node = next;
+    }
+
+    std::reverse(_batch.begin() + first, _batch.end());
+
+    return static_cast<unsigned int>(_batch.size());
+}
+
+void SceneCommandQueue::applyBatch()
+{
+    if(_batch.empty())
+        return;
+
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+
+    // commands pushed by the commands themselves go to the next batch
+    for(std::vector<Command>::iterator itr = _batch.begin(); itr != _batch.end(); ++itr)
+    {
+        (*itr)();
+    }
+
+    double applyTime = osg::Timer::instance()->delta_s(startTick, osg::Timer::instance()->tick());
+    unsigned int batchSize = static_cast<unsigned int>(_batch.size());
+
+    _stats.numApplied += batchSize;
+    ++_stats.numBatches;
+    _stats.maxBatchSize = std::max(_stats.maxBatchSize, batchSize);
+    _stats.applyTime += applyTime;
+    _stats.maxApplyTime = std::max(_stats.maxApplyTime, applyTime);
+
+    _batch.clear();
+}
+
+SceneCommandQueue::Stats SceneCommandQueue::getStats() const
+{
+    Stats stats = _stats;
+    stats.numPushed = _numPushed.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void SceneCommandQueue::resetStats()
+{
+    _stats = Stats();
+    _numPushed = 0;
+}
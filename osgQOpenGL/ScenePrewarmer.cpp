@@ -0,0 +1,253 @@
+#include <osgQOpenGL/ScenePrewarmer>
+#include <osgQOpenGL/FrameTracer>
+
+#include <osg/Group>
+#include <osg/NodeVisitor>
+#include <osgDB/ReadFile>
+#include <osgUtil/GLObjectsVisitor>
+#include <osgUtil/Optimizer>
+#include <osgViewer/GraphicsWindow>
+
+#include <QMutexLocker>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QRunnable>
+
+#include <vector>
+
+// Computes the bounds of all nodes and drawables, which the first cull traversal
+// would do otherwise.
+class ScenePrewarmer::PrepareVisitor : public osg::NodeVisitor
+{
+public:
+    PrepareVisitor() :
+        osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN)
+    {
+        setNodeMaskOverride(0xffffffff);
+    }
+
+    void apply(osg::Node& node) override
+    {
+        node.getBound();
+        traverse(node);
+    }
+
+    void apply(osg::Drawable& drawable) override
+    {
+        drawable.getBoundingBox();
+        drawable.getBound();
+    }
+};
+
+class ScenePrewarmer::LoadTask : public QRunnable
+{
+public:
+    LoadTask(const std::string& path, osg::Node* node, osgDB::Options* options,
+             bool optimize, osg::ref_ptr<osg::Node>& result) :
+        _path(path),
+        _node(node),
+        _options(options),
+        _optimize(optimize),
+        _result(result) {}
+
+    void run() override
+    {
+        osg::ref_ptr<osg::Node> node = _node;
+
+        if(!node.valid())
+        {
+            OSGQOPENGL_TRACE_ZONE("prewarm read");
+            node = osgDB::readRefNodeFile(_path, _options.get());
+
+            if(node.valid() && _optimize)
+            {
+                osgUtil::Optimizer optimizer;
+                optimizer.optimize(node.get());
+            }
+        }
+
+        if(node.valid())
+        {
+            PrepareVisitor visitor;
+            node->accept(visitor);
+        }
+
+        _result = node;
+    }
+
+protected:
+    std::string                     _path;
+    osg::ref_ptr<osg::Node>         _node;
+    osg::ref_ptr<osgDB::Options>    _options;
+    bool                            _optimize;
+    osg::ref_ptr<osg::Node>&        _result;
+};
+
+ScenePrewarmer::ScenePrewarmer(QObject* parent) :
+    QThread(parent)
+{
+    connect(this, &QThread::finished, this, &ScenePrewarmer::done);
+}
+
+ScenePrewarmer::~ScenePrewarmer()
+{
+    wait();
+    delete _surface;
+}
+
+void ScenePrewarmer::addFile(const QString& path)
+{
+    _files.append(path);
+}
+
+osg::Node* ScenePrewarmer::sceneData() const
+{
+    QMutexLocker locker(&_mutex);
+    return _scene.get();
+}
+
+ScenePrewarmer::Timings ScenePrewarmer::timings() const
+{
+    QMutexLocker locker(&_mutex);
+    return _timings;
+}
+
+void ScenePrewarmer::prewarm()
+{
+    if(isRunning())
+        return;
+
+    QOpenGLContext* shareContext = QOpenGLContext::globalShareContext();
+
+    if(shareContext && !_context)
+    {
+        // surfaces can only be created on the GUI thread, the context is then used by run()
+        if(!_surface)
+        {
+            _surface = new QOffscreenSurface();
+            _surface->setFormat(shareContext->format());
+            _surface->create();
+        }
+
+        _context = new QOpenGLContext();
+        _context->setShareContext(shareContext);
+        _context->setFormat(shareContext->format());
+
+        if(_context->create())
+        {
+            _context->moveToThread(this);
+        }
+        else
+        {
+            delete _context;
+            _context = nullptr;
+        }
+    }
+
+    if(_context && !_graphicsContext.valid())
+    {
+        _graphicsContext = new osgViewer::GraphicsWindowEmbedded(0, 0, 1, 1);
+        _graphicsContext->realize();
+    }
+
+    start();
+}
+
+void ScenePrewarmer::run()
+{
+    OSGQOPENGL_TRACE_ZONE("prewarm");
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+
+    std::vector< osg::ref_ptr<osg::Node> > nodes(_files.size() + (_inputScene.valid() ? 1 : 0));
+
+    for(int i = 0; i < _files.size(); ++i)
+    {
+        _pool.start(new LoadTask(_files[i].toLocal8Bit().toStdString(), nullptr,
+                                 _options.get(), _optimize, nodes[i]));
+    }
+
+    if(_inputScene.valid())
+        _pool.start(new LoadTask(std::string(), _inputScene.get(), nullptr, false, nodes.back()));
+
+    _pool.waitForDone();
+
+    Timings timings;
+    timings.numFiles = _files.size();
+    timings.loadTime = osg::Timer::instance()->delta_s(startTick, osg::Timer::instance()->tick());
+
+    osg::ref_ptr<osg::Group> group = new osg::Group;
+
+    for(unsigned int i = 0; i < nodes.size(); ++i)
+    {
+        if(nodes[i].valid())
+            group->addChild(nodes[i].get());
+        else
+            ++timings.numFailedFiles;
+    }
+
+    osg::ref_ptr<osg::Node> scene;
+
+    if(group->getNumChildren() == 1)
+        scene = group->getChild(0);
+    else if(group->getNumChildren() > 1)
+        scene = group;
+
+    if(scene.valid() && _context)
+    {
+        osg::Timer_t compileTick = osg::Timer::instance()->tick();
+        timings.compiled = compile(scene.get());
+        timings.compileTime = osg::Timer::instance()->delta_s(compileTick, osg::Timer::instance()->tick());
+    }
+
+    // the context belongs to this thread
+    delete _context;
+    _context = nullptr;
+
+    timings.totalTime = osg::Timer::instance()->delta_s(startTick, osg::Timer::instance()->tick());
+
+    QMutexLocker locker(&_mutex);
+    _scene = scene;
+    _timings = timings;
+}
+
+bool ScenePrewarmer::compile(osg::Node* scene)
+{
+    OSGQOPENGL_TRACE_ZONE("prewarm compile");
+
+    if(!_context->makeCurrent(_surface))
+        return false;
+
+    // sets up the extensions of the context id, the embedded window has nothing to make current
+    _graphicsContext->makeCurrent();
+
+    osg::State* state = _graphicsContext->getState();
+    state->setUseVertexArrayObject(false);
+
+    osgUtil::GLObjectsVisitor visitor(osgUtil::GLObjectsVisitor::COMPILE_DISPLAY_LISTS |
+                                      osgUtil::GLObjectsVisitor::COMPILE_STATE_ATTRIBUTES |
+                                      osgUtil::GLObjectsVisitor::CHECK_BLACK_LISTED_MODES);
+    visitor.setNodeMaskOverride(0xffffffff);
+    visitor.setState(state);
+    scene->accept(visitor);
+
+    // the objects are complete when the window's context first uses them
+    _context->functions()->glFinish();
+
+    _graphicsContext->releaseContext();
+    _context->doneCurrent();
+    return true;
+}
+
+void ScenePrewarmer::done()
+{
+    delete _surface;
+    _surface = nullptr;
+
+    Timings t = timings();
+    OSG_INFO << "ScenePrewarmer: " << t.numFiles << " files, " << t.numFailedFiles << " failed, load "
+             << t.loadTime * 1000.0 << " ms, compile " << t.compileTime * 1000.0 << " ms, total "
+             << t.totalTime * 1000.0 << " ms" << std::endl;
+
+    emit prewarmed(t.compiled);
+}
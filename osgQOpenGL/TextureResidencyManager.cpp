@@ -0,0 +1,295 @@
+#include <osgQOpenGL/TextureResidencyManager>
+
+#include <osg/Image>
+
+#include <algorithm>
+
+TextureResidencyManager::TextureResidencyManager() :
+    _budget(0),
+    _uploadBudget(16 * 1024 * 1024),
+    _minimumIdleFrames(60),
+    _state(0),
+    _frameNumber(0),
+    _uploadedThisFrame(0),
+    _uploadedAny(false)
+{
+}
+
+void TextureResidencyManager::resetStats()
+{
+    unsigned int numTextures = _stats.numTextures;
+    unsigned int numEvicted = _stats.numEvicted;
+
+    _stats = Stats();
+    _stats.numTextures = numTextures;
+    _stats.numEvicted = numEvicted;
+}
+
+void TextureResidencyManager::reportStats(osg::Stats& stats, unsigned int frameNumber) const
+{
+    stats.setAttribute(frameNumber, "Residency textures", _stats.numTextures);
+    stats.setAttribute(frameNumber, "Residency evicted textures", _stats.numEvicted);
+    stats.setAttribute(frameNumber, "Residency evictions", _stats.numEvictions);
+    stats.setAttribute(frameNumber, "Residency evicted bytes", _stats.evictedBytes);
+    stats.setAttribute(frameNumber, "Residency uploads", _stats.numUploads);
+    stats.setAttribute(frameNumber, "Residency uploaded bytes", _stats.uploadedBytes);
+    stats.setAttribute(frameNumber, "Residency deferred uploads", _stats.numDeferredUploads);
+}
+
+void TextureResidencyManager::beginDraw(osg::State& state, osgUtil::RenderBin* bin, HiddenLeaves& hidden)
+{
+    unsigned int frameNumber = state.getFrameStamp() ? state.getFrameStamp()->getFrameNumber() : 0;
+
+    if(frameNumber != _frameNumber)
+    {
+        _frameNumber = frameNumber;
+        _uploadedThisFrame = 0;
+        _uploadedAny = false;
+    }
+
+    _state = &state;
+    _pendingStateGraphs.clear();
+
+    hideLeaves(bin, hidden);
+
+    _state = 0;
+}
+
+void TextureResidencyManager::endDraw(HiddenLeaves& hidden)
+{
+    for(unsigned int i = 0; i < hidden.stateGraphLeaves.size(); ++i)
+    {
+        hidden.stateGraphLeaves[i].first->_leaves.swap(hidden.stateGraphLeaves[i].second);
+    }
+
+    for(unsigned int i = 0; i < hidden.binLeaves.size(); ++i)
+    {
+        hidden.binLeaves[i].first->getRenderLeafList().swap(hidden.binLeaves[i].second);
+    }
+
+    hidden.stateGraphLeaves.clear();
+    hidden.binLeaves.clear();
+}
+
+void TextureResidencyManager::hideLeaves(osgUtil::RenderBin* bin, HiddenLeaves& hidden)
+{
+    for(osgUtil::RenderBin::RenderBinList::iterator itr = bin->getRenderBinList().begin();
+        itr != bin->getRenderBinList().end();
+        ++itr)
+    {
+        hideLeaves(itr->second.get(), hidden);
+    }
+
+    for(osgUtil::RenderBin::StateGraphList::iterator itr = bin->getStateGraphList().begin();
+        itr != bin->getStateGraphList().end();
+        ++itr)
+    {
+        osgUtil::StateGraph* sg = *itr;
+
+        if(isPending(sg) && !sg->_leaves.empty())
+        {
+            hidden.stateGraphLeaves.push_back(std::make_pair(sg, osgUtil::StateGraph::LeafList()));
+            hidden.stateGraphLeaves.back().second.swap(sg->_leaves);
+        }
+    }
+
+    // depth sorted bins hold their leaves directly
+    osgUtil::RenderBin::RenderLeafList& leaves = bin->getRenderLeafList();
+    osgUtil::RenderBin::RenderLeafList visibleLeaves;
+    bool anyPending = false;
+
+    for(osgUtil::RenderBin::RenderLeafList::iterator itr = leaves.begin(); itr != leaves.end(); ++itr)
+    {
+        if(isPending((*itr)->_parent))
+            anyPending = true;
+        else
+            visibleLeaves.push_back(*itr);
+    }
+
+    if(anyPending)
+    {
+        hidden.binLeaves.push_back(std::make_pair(bin, visibleLeaves));
+        hidden.binLeaves.back().second.swap(leaves);
+    }
+}
+
+bool TextureResidencyManager::isPending(osgUtil::StateGraph* stateGraph)
+{
+    if(!stateGraph)
+        return false;
+
+    std::map<osgUtil::StateGraph*, bool>::iterator itr = _pendingStateGraphs.find(stateGraph);
+
+    if(itr != _pendingStateGraphs.end())
+        return itr->second;
+
+    // the textures of every state set above the leaves are applied for them
+    bool pending = isPending(stateGraph->_stateset);
+    pending = isPending(stateGraph->_parent) || pending;
+
+    _pendingStateGraphs[stateGraph] = pending;
+    return pending;
+}
+
+bool TextureResidencyManager::isPending(const osg::StateSet* stateSet)
+{
+    if(!stateSet)
+        return false;
+
+    const osg::StateSet::TextureAttributeList& textureAttributes = stateSet->getTextureAttributeList();
+    bool pending = false;
+
+    for(unsigned int unit = 0; unit < textureAttributes.size(); ++unit)
+    {
+        for(osg::StateSet::AttributeList::const_iterator itr = textureAttributes[unit].begin();
+            itr != textureAttributes[unit].end();
+            ++itr)
+        {
+            const osg::Texture* texture = itr->second.first.valid() ? itr->second.first->asTexture() : 0;
+
+            if(texture && use(const_cast<osg::Texture*>(texture)).pending)
+                pending = true;
+        }
+    }
+
+    return pending;
+}
+
+TextureResidencyManager::Entry& TextureResidencyManager::use(osg::Texture* texture)
+{
+    Entry& entry = _entries[texture];
+
+    if(!entry.texture.valid())
+    {
+        // new entry, or a new texture at the address of a deleted one
+        if(entry.evicted)
+            --_stats.numEvicted;
+
+        entry = Entry();
+        entry.texture = texture;
+
+        // keep the images to upload the texture again after an eviction
+        texture->setUnRefImageDataAfterApply(false);
+    }
+    else if(entry.lastUsedFrame == _frameNumber)
+    {
+        return entry;
+    }
+
+    entry.lastUsedFrame = _frameNumber;
+    entry.pending = false;
+
+    if(!entry.evicted)
+        return entry;
+
+    if(_uploadedAny && _uploadedThisFrame >= _uploadBudget)
+    {
+        entry.pending = true;
+        ++_stats.numDeferredUploads;
+        return entry;
+    }
+
+    _state->setActiveTextureUnit(0);
+    texture->apply(*_state);
+    _state->haveAppliedTextureAttribute(0, texture);
+
+    osg::Texture::TextureObject* textureObject = texture->getTextureObject(_state->getContextID());
+    unsigned long long bytes = textureObject ? textureObject->size() : 0;
+
+    entry.evicted = false;
+    --_stats.numEvicted;
+    ++_stats.numUploads;
+    _stats.uploadedBytes += bytes;
+    _uploadedThisFrame += bytes;
+    _uploadedAny = true;
+
+    return entry;
+}
+
+bool TextureResidencyManager::hasImages(const osg::Texture* texture)
+{
+    if(texture->getNumImages() == 0)
+        return false;
+
+    for(unsigned int i = 0; i < texture->getNumImages(); ++i)
+    {
+        const osg::Image* image = texture->getImage(i);
+
+        if(!image || !image->data())
+            return false;
+    }
+
+    return true;
+}
+
+void TextureResidencyManager::evict(osg::State& state)
+{
+    unsigned int contextID = state.getContextID();
+    unsigned int frameNumber = state.getFrameStamp() ? state.getFrameStamp()->getFrameNumber() : _frameNumber;
+
+    for(EntryMap::iterator itr = _entries.begin(); itr != _entries.end();)
+    {
+        if(!itr->second.texture.valid())
+        {
+            if(itr->second.evicted)
+                --_stats.numEvicted;
+
+            _entries.erase(itr++);
+        }
+        else
+        {
+            ++itr;
+        }
+    }
+
+    _stats.numTextures = static_cast<unsigned int>(_entries.size());
+
+    if(_budget == 0)
+        return;
+
+    osg::TextureObjectManager* textureObjectManager = osg::get<osg::TextureObjectManager>(contextID);
+
+    if(textureObjectManager->getCurrTexturePoolSize() <= _budget)
+        return;
+
+    // the orphaned objects kept for reuse go first
+    textureObjectManager->flushAllDeletedGLObjects();
+    unsigned long long poolSize = textureObjectManager->getCurrTexturePoolSize();
+
+    if(poolSize <= _budget)
+        return;
+
+    typedef std::vector< std::pair<unsigned int, osg::Texture*> > CandidateList;
+    CandidateList candidates;
+
+    for(EntryMap::iterator itr = _entries.begin(); itr != _entries.end(); ++itr)
+    {
+        osg::Texture* texture = itr->second.texture.get();
+
+        if(!itr->second.evicted
+           && frameNumber - itr->second.lastUsedFrame >= _minimumIdleFrames
+           && texture->getTextureObject(contextID)
+           && hasImages(texture))
+        {
+            candidates.push_back(std::make_pair(itr->second.lastUsedFrame, texture));
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end());
+
+    for(CandidateList::iterator itr = candidates.begin(); itr != candidates.end() && poolSize > _budget; ++itr)
+    {
+        osg::Texture* texture = itr->second;
+        unsigned long long bytes = texture->getTextureObject(contextID)->size();
+
+        texture->releaseGLObjects(&state);
+        poolSize -= std::min(bytes, poolSize);
+
+        _entries[texture].evicted = true;
+        ++_stats.numEvicted;
+        ++_stats.numEvictions;
+        _stats.evictedBytes += bytes;
+    }
+
+    textureObjectManager->flushAllDeletedGLObjects();
+}
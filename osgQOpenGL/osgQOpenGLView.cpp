@@ -1,11 +1,13 @@
 #include <osgQOpenGL/osgQOpenGLView>
 #include <osgQOpenGL/OSGRenderer>
 #include <osgQOpenGL/GraphicsScene>
+#include <osgQOpenGL/osgQOpenGLViewItem>
 
 #include <osgViewer/Viewer>
 #include <osg/GL>
 
 #include <QApplication>
+#include <QGraphicsWidget>
 #include <QOpenGLWidget>
 #include <QKeyEvent>
 #include <QInputDialog>
@@ -59,9 +61,49 @@ OpenThreads::ReadWriteMutex* osgQOpenGLView::mutex()
     return &_osgMutex;
 }
 
+ModelLoadHandle* osgQOpenGLView::loadAsync(const QString& path, osg::Group* parent)
+{
+    return renderer()->loadAsync(path, parent);
+}
+
+ModelLoader* osgQOpenGLView::modelLoader()
+{
+    return renderer()->modelLoader();
+}
+
+void osgQOpenGLView::setPrewarmer(ScenePrewarmer* prewarmer)
+{
+    renderer()->setPrewarmer(prewarmer);
+}
+
+ScenePrewarmer* osgQOpenGLView::prewarmer() const
+{
+    return m_renderer ? m_renderer->prewarmer() : nullptr;
+}
+
+OSGRenderer* osgQOpenGLView::renderer()
+{
+    if(!m_renderer)
+    {
+        // call this before creating a View...
+        setDefaultDisplaySettings();
+
+        if(!_arguments)
+            m_renderer = new OSGRenderer(this, enQGLView);
+        else
+            m_renderer = new OSGRenderer(_arguments, this, enQGLView);
+
+        m_renderer->markStartup(OSGRenderer::WidgetConstructed, _constructTick);
+    }
+
+    return m_renderer;
+}
+
 
 void osgQOpenGLView::initializeGL()
 {
+    osg::Timer_t initializeTick = osg::Timer::instance()->tick();
+    renderer()->markStartup(OSGRenderer::InitializeGL, initializeTick);
     initializeOpenGLFunctions();
     createRenderer();
     emit initialized();
@@ -82,13 +124,12 @@ void osgQOpenGLView::resizeGL(int w, int h)
 
 void osgQOpenGLView::paintGL()
 {
+    OSGQOPENGL_TRACE_ZONE("paintGL");
+    osg::Timer_t lockTick = osg::Timer::instance()->tick();
     OpenThreads::ScopedReadLock locker(_osgMutex);
-	if (_isFirstFrame) {
-		_isFirstFrame = false;
-		auto wgt = (QOpenGLWidget*)viewport();
-		m_renderer->getCamera()->getGraphicsContext()
-			->setDefaultFboId(wgt->defaultFramebufferObject());
-	}
+    m_renderer->recordReadLockWait(osg::Timer::instance()->delta_s(lockTick, osg::Timer::instance()->tick()));
+	auto wgt = (QOpenGLWidget*)viewport();
+	m_renderer->setDefaultFramebuffer(wgt->defaultFramebufferObject());
 	m_renderer->frame();
 }
 
@@ -202,9 +243,158 @@ void osgQOpenGLView::keyReleaseEvent(QKeyEvent* event)
     m_renderer->keyReleaseEvent(event);
 }
 
+void osgQOpenGLView::collectOverlays()
+{
+    for(std::vector<QMetaObject::Connection>::iterator itr = _overlayConnections.begin();
+        itr != _overlayConnections.end();
+        ++itr)
+    {
+        disconnect(*itr);
+    }
+
+    _overlayConnections.clear();
+    _overlayItems.clear();
+    _overlayScene = scene();
+    _overlayItemsDirty = false;
+    _overlayIndexDirty = true;
+
+    if(!_overlayScene)
+        return;
+
+    QList<QGraphicsItem*> items = _overlayScene->items();
+    auto dirtyIndex = [this]() { _overlayIndexDirty = true; };
+
+    foreach(QGraphicsItem* item, items)
+    {
+        if(item->acceptedMouseButtons() == Qt::NoButton && !item->acceptHoverEvents())
+            continue;
+
+        // hidden QGraphicsObjects are followed until they are shown
+        OverlayItem overlay;
+        overlay.object = item->toGraphicsObject();
+        overlay.followed = overlay.object;
+
+        if(!overlay.followed && !item->isVisible())
+            continue;
+
+        overlay.rect = item->isVisible() ? item->sceneBoundingRect() : QRectF();
+        _overlayItems.push_back(overlay);
+
+        if(!overlay.object)
+            continue;
+
+        // the scene bounding rect follows the item's and its parents' geometry
+        for(QGraphicsItem* parent = item; parent; parent = parent->parentItem())
+        {
+            QGraphicsObject* object = parent->toGraphicsObject();
+
+            if(!object)
+                continue;
+
+            _overlayConnections.push_back(connect(object, &QGraphicsObject::xChanged, this, dirtyIndex));
+            _overlayConnections.push_back(connect(object, &QGraphicsObject::yChanged, this, dirtyIndex));
+            _overlayConnections.push_back(connect(object, &QGraphicsObject::rotationChanged, this, dirtyIndex));
+            _overlayConnections.push_back(connect(object, &QGraphicsObject::scaleChanged, this, dirtyIndex));
+            _overlayConnections.push_back(connect(object, &QGraphicsObject::visibleChanged, this, dirtyIndex));
+            _overlayConnections.push_back(connect(object, &QGraphicsObject::parentChanged, this, dirtyIndex));
+            _overlayConnections.push_back(connect(object, &QObject::destroyed, this, dirtyIndex));
+
+            if(QGraphicsWidget* widget = qobject_cast<QGraphicsWidget*>(object))
+            {
+                _overlayConnections.push_back(connect(widget, &QGraphicsWidget::geometryChanged, this,
+                                                      dirtyIndex));
+            }
+        }
+    }
+}
+
+bool osgQOpenGLView::overlayAt(const QPoint& pos)
+{
+    if(_overlayItemsDirty || _overlayScene != scene())
+        collectOverlays();
+
+    if(_overlayIndexDirty)
+    {
+        std::vector<QRectF> rects;
+
+        for(std::vector<OverlayItem>::iterator itr = _overlayItems.begin(); itr != _overlayItems.end(); ++itr)
+        {
+            // the rects of the other items are kept from the last collectOverlays()
+            if(itr->followed)
+                itr->rect = itr->object && itr->object->isVisible() ? itr->object->sceneBoundingRect() :
+                            QRectF();
+
+            rects.push_back(itr->rect);
+        }
+
+        _overlayIndex.build(rects);
+        _overlayIndexDirty = false;
+    }
+
+    return _overlayIndex.contains(mapToScene(pos));
+}
+
+bool osgQOpenGLView::routeToRenderer(const QPoint& pos, bool press, bool& sample)
+{
+    sample = false;
+
+    // the events below go through the scene, which then knows what is hovered
+    if(!_overlayRouting || !scene() || !m_renderer || !m_renderer->isOsgInitialized())
+    {
+        _overlayHovered = true;
+        return false;
+    }
+
+    // the scene has to see the events of grabs, drags, and of presses that may
+    // clear the focus or the selection
+    if(scene()->mouseGrabberItem() || dragMode() != QGraphicsView::NoDrag
+       || (press && (scene()->focusItem() || !scene()->selectedItems().isEmpty())))
+    {
+        _overlayHovered = true;
+        return false;
+    }
+
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+    bool hit = overlayAt(pos);
+    _routingStats.hitTestTime += osg::Timer::instance()->delta_s(startTick, osg::Timer::instance()->tick());
+
+    // the item hovered last needs the move that leaves it
+    bool leaving = _overlayHovered;
+    _overlayHovered = hit;
+
+    if(hit || leaving)
+        return false;
+
+    // one in 64 goes through the scene to time what the others skip
+    sample = (++_overlaySampleCounter & 63) == 0;
+    return !sample;
+}
+
 void osgQOpenGLView::mousePressEvent(QMouseEvent* event)
 {
+    bool sample;
+
+    if(routeToRenderer(event->pos(), true, sample))
+    {
+        ++_routingStats.fastPathEvents;
+        m_renderer->mousePressEvent(event);
+        return;
+    }
+
+    osg::Timer_t sceneTick = osg::Timer::instance()->tick();
 	QGraphicsView::mousePressEvent(event);
+    double sceneTime = osg::Timer::instance()->delta_s(sceneTick, osg::Timer::instance()->tick());
+
+    if(sample)
+    {
+        _routingStats.sampledTime += sceneTime;
+        ++_routingStats.sampledEvents;
+    }
+    else
+    {
+        _routingStats.sceneTime += sceneTime;
+        ++_routingStats.sceneEvents;
+    }
 
 	if (event->isAccepted())
 		return;
@@ -234,7 +424,29 @@ void osgQOpenGLView::mouseDoubleClickEvent(QMouseEvent* event)
 
 void osgQOpenGLView::mouseMoveEvent(QMouseEvent* event)
 {
+    bool sample;
+
+    if(routeToRenderer(event->pos(), false, sample))
+    {
+        ++_routingStats.fastPathEvents;
+        m_renderer->mouseMoveEvent(event);
+        return;
+    }
+
+    osg::Timer_t sceneTick = osg::Timer::instance()->tick();
 	QGraphicsView::mouseMoveEvent(event);
+    double sceneTime = osg::Timer::instance()->delta_s(sceneTick, osg::Timer::instance()->tick());
+
+    if(sample)
+    {
+        _routingStats.sampledTime += sceneTime;
+        ++_routingStats.sampledEvents;
+    }
+    else
+    {
+        _routingStats.sceneTime += sceneTime;
+        ++_routingStats.sceneEvents;
+    }
 
 	if (event->isAccepted())
 		return;
@@ -276,21 +488,86 @@ void osgQOpenGLView::init()
 
 void osgQOpenGLView::createRenderer()
 {
-    // call this before creating a View...
-    setDefaultDisplaySettings();
-	if (!_arguments) {
-		m_renderer = new OSGRenderer(this, enQGLView);
-	} else {
-		m_renderer = new OSGRenderer(_arguments, this, enQGLView);
-	}
 	QScreen* screen = windowHandle()
                       && windowHandle()->screen() ? windowHandle()->screen() :
                       qApp->screens().front();
-    m_renderer->setupOSG(width(), height(), screen->devicePixelRatio());
+    renderer()->setupOSG(width(), height(), screen->devicePixelRatio());
+
+    // the scene is drawn into the viewport widget, composed with the view
+    if(QOpenGLWidget* wgt = qobject_cast<QOpenGLWidget*>(viewport()))
+        connect(wgt, &QOpenGLWidget::frameSwapped, m_renderer, &OSGRenderer::framePresented);
+}
+
+void osgQOpenGLView::addViewItem(osgQOpenGLViewItem* item)
+{
+    if(item->scene() != scene())
+        scene()->addItem(item);
+
+    // the item takes hover events and mouse buttons like any other overlay
+    invalidateOverlays();
+
+    ViewItem viewItem;
+    viewItem.item = item;
+    viewItem.camera = item->camera();
+    _viewItems.push_back(viewItem);
+    viewport()->update();
+}
+
+void osgQOpenGLView::updateViewItems(const QRectF& rect)
+{
+    if(!m_renderer || !m_renderer->isOsgInitialized())
+        return;
+
+    qreal ratio = viewport()->devicePixelRatioF();
+    int height = static_cast<int>(viewport()->height() * ratio);
+
+    for(std::vector<ViewItem>::iterator itr = _viewItems.begin(); itr != _viewItems.end();)
+    {
+        if(!itr->item)
+        {
+            if(itr->attached)
+            {
+                // the viewport's context is current while the background is drawn
+                osg::GraphicsContext* gc = itr->camera->getGraphicsContext();
+                itr->camera->releaseGLObjects(gc ? gc->getState() : nullptr);
+                m_renderer->removeSlave(m_renderer->findSlaveIndexForCamera(itr->camera.get()));
+                itr->camera->setGraphicsContext(nullptr);
+            }
+
+            itr = _viewItems.erase(itr);
+            continue;
+        }
+
+        if(!itr->attached)
+        {
+            // the slave gets a renderer of its own that draws in the main camera's context
+            osg::Camera* master = m_renderer->getCamera();
+            itr->camera->setGraphicsContext(master->getGraphicsContext());
+            itr->camera->setDrawBuffer(master->getDrawBuffer());
+            itr->camera->setReadBuffer(master->getReadBuffer());
+            itr->attached = m_renderer->addSlave(itr->camera.get(), false);
+        }
+
+        osgQOpenGLViewItem* item = itr->item;
+        QRectF sceneRect = item->sceneBoundingRect();
+        QRect r = mapFromScene(sceneRect).boundingRect();
+        bool exposed = item->scene() == scene()
+                       && item->isVisible()
+                       && sceneRect.intersects(rect)
+                       && r.intersects(viewport()->rect());
+
+        item->updateCamera(static_cast<int>(r.x() * ratio),
+                           height - static_cast<int>((r.y() + r.height()) * ratio),
+                           static_cast<int>(r.width() * ratio),
+                           static_cast<int>(r.height() * ratio), exposed);
+        ++itr;
+    }
 }
 
 void osgQOpenGLView::drawBackground(QPainter * painter, const QRectF & rect)
 {
+    updateViewItems(rect);
+
 	painter->save();
 	painter->beginNativePainting();
 	paintGL();
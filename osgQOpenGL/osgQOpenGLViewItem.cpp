@@ -0,0 +1,126 @@
+#include <osgQOpenGL/osgQOpenGLViewItem>
+
+#include <osg/Viewport>
+
+#include <algorithm>
+
+osgQOpenGLViewItem::osgQOpenGLViewItem(const QSizeF& size, QGraphicsItem* parent)
+    : QGraphicsObject(parent),
+      _size(size)
+{
+    _camera = new osg::Camera();
+    _camera->setName("osgQOpenGLViewItem");
+    _camera->setReferenceFrame(osg::Transform::ABSOLUTE_RF);
+    // after the main camera, which clears the whole window
+    _camera->setRenderOrder(osg::Camera::POST_RENDER);
+    _camera->setClearMask(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    _camera->setClearColor(osg::Vec4(0.2f, 0.2f, 0.4f, 1.0f));
+    _camera->setViewport(new osg::Viewport(0, 0, 1, 1));
+    _camera->setAllowEventFocus(false);
+
+    _scissor = new osg::Scissor(0, 0, 1, 1);
+    _camera->getOrCreateStateSet()->setAttributeAndModes(_scissor.get(), osg::StateAttribute::ON);
+
+    // the mouse goes through to the view's renderer
+    setAcceptedMouseButtons(Qt::NoButton);
+}
+
+osgQOpenGLViewItem::~osgQOpenGLViewItem()
+{
+}
+
+void osgQOpenGLViewItem::setSize(const QSizeF& size)
+{
+    prepareGeometryChange();
+    _size = size;
+}
+
+void osgQOpenGLViewItem::setSceneData(osg::Node* node)
+{
+    _camera->removeChildren(0, _camera->getNumChildren());
+
+    if(node)
+        _camera->addChild(node);
+}
+
+osg::Node* osgQOpenGLViewItem::sceneData() const
+{
+    return _camera->getNumChildren() > 0 ? _camera->getChild(0) : nullptr;
+}
+
+QRectF osgQOpenGLViewItem::boundingRect() const
+{
+    return QRectF(QPointF(0.0, 0.0), _size);
+}
+
+void osgQOpenGLViewItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
+{
+    // the camera draws the item's content with the view's background
+    Q_UNUSED(painter);
+    Q_UNUSED(option);
+    Q_UNUSED(widget);
+}
+
+void osgQOpenGLViewItem::updateCamera(int x, int y, int width, int height, bool exposed)
+{
+    if(!exposed || width <= 0 || height <= 0)
+    {
+        if(!_skipped)
+        {
+            _skipped = true;
+            _cullMask = _camera->getCullMask();
+            _clearMask = _camera->getClearMask();
+            _camera->setCullMask(0);
+            _camera->setClearMask(0);
+        }
+
+        return;
+    }
+
+    if(_skipped)
+    {
+        _skipped = false;
+        _camera->setCullMask(_cullMask);
+        _camera->setClearMask(_clearMask);
+    }
+
+    _camera->getViewport()->setViewport(x, y, width, height);
+    _scissor->setScissor(x, y, width, height);
+
+    if(_fieldOfView > 0.0)
+    {
+        double zNear = _zNear;
+        double zFar = _zFar;
+
+        if(zFar <= 0.0 && !computeNearFar(zNear, zFar))
+        {
+            // nothing to see, any planes do
+            zNear = 1.0;
+            zFar = 10000.0;
+        }
+
+        _camera->setProjectionMatrixAsPerspective(_fieldOfView, static_cast<double>(width) / height,
+                                                  zNear, zFar);
+    }
+}
+
+bool osgQOpenGLViewItem::computeNearFar(double& zNear, double& zFar) const
+{
+    osg::Node* node = sceneData();
+
+    if(!node || !node->getBound().valid())
+        return false;
+
+    const osg::BoundingSphere& bound = node->getBound();
+
+    // distance of the center along the view direction, the camera looks down -z
+    double distance = -(bound.center() * _camera->getViewMatrix()).z();
+    zFar = distance + bound.radius();
+
+    if(zFar <= 0.0)
+        return false;
+
+    // the camera may be inside the sphere
+    zNear = std::max(distance - bound.radius(), zFar * _camera->getNearFarRatio());
+    return true;
+}
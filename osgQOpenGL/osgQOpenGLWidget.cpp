@@ -40,9 +40,49 @@ OpenThreads::ReadWriteMutex* osgQOpenGLWidget::mutex()
     return &_osgMutex;
 }
 
+ModelLoadHandle* osgQOpenGLWidget::loadAsync(const QString& path, osg::Group* parent)
+{
+    return renderer()->loadAsync(path, parent);
+}
+
+ModelLoader* osgQOpenGLWidget::modelLoader()
+{
+    return renderer()->modelLoader();
+}
+
+void osgQOpenGLWidget::setPrewarmer(ScenePrewarmer* prewarmer)
+{
+    renderer()->setPrewarmer(prewarmer);
+}
+
+ScenePrewarmer* osgQOpenGLWidget::prewarmer() const
+{
+    return m_renderer ? m_renderer->prewarmer() : nullptr;
+}
+
+OSGRenderer* osgQOpenGLWidget::renderer()
+{
+    if(!m_renderer)
+    {
+        // call this before creating a View...
+        setDefaultDisplaySettings();
+
+        if(!_arguments)
+            m_renderer = new OSGRenderer(this, enQGLWidget);
+        else
+            m_renderer = new OSGRenderer(_arguments, this, enQGLWidget);
+
+        m_renderer->markStartup(OSGRenderer::WidgetConstructed, _constructTick);
+    }
+
+    return m_renderer;
+}
+
 
 void osgQOpenGLWidget::initializeGL()
 {
+    osg::Timer_t initializeTick = osg::Timer::instance()->tick();
+    renderer()->markStartup(OSGRenderer::InitializeGL, initializeTick);
     // Initializes OpenGL function resolution for the current context.
     initializeOpenGLFunctions();
     createRenderer();
@@ -60,11 +100,11 @@ void osgQOpenGLWidget::resizeGL(int w, int h)
 
 void osgQOpenGLWidget::paintGL()
 {
+    OSGQOPENGL_TRACE_ZONE("paintGL");
+    osg::Timer_t lockTick = osg::Timer::instance()->tick();
     OpenThreads::ScopedReadLock locker(_osgMutex);
-	if (_isFirstFrame) {
-		_isFirstFrame = false;
-		m_renderer->getCamera()->getGraphicsContext()->setDefaultFboId(defaultFramebufferObject());
-	}
+    m_renderer->recordReadLockWait(osg::Timer::instance()->delta_s(lockTick, osg::Timer::instance()->tick()));
+    m_renderer->setDefaultFramebuffer(defaultFramebufferObject());
 	m_renderer->frame();
 }
 
@@ -208,15 +248,10 @@ void osgQOpenGLWidget::setDefaultDisplaySettings()
 
 void osgQOpenGLWidget::createRenderer()
 {
-    // call this before creating a View...
-    setDefaultDisplaySettings();
-	if (!_arguments) {
-		m_renderer = new OSGRenderer(this, enQGLWidget);
-	} else {
-		m_renderer = new OSGRenderer(_arguments, this, enQGLWidget);
-	}
 	QScreen* screen = windowHandle()
                       && windowHandle()->screen() ? windowHandle()->screen() :
                       qApp->screens().front();
-    m_renderer->setupOSG(width(), height(), screen->devicePixelRatio());
+    renderer()->setupOSG(width(), height(), screen->devicePixelRatio());
+    // the frame is on screen once composed with the other widgets
+    connect(this, &QOpenGLWidget::frameSwapped, m_renderer, &OSGRenderer::framePresented);
 }
@@ -13,13 +13,14 @@
 #include <QDebug>
 
 
-osgQOpenGLWindow::osgQOpenGLWindow()
-    : QOpenGLWindow(QOpenGLWindow::NoPartialUpdate, nullptr)
+osgQOpenGLWindow::osgQOpenGLWindow(UpdateBehavior updateBehavior)
+    : QOpenGLWindow(updateBehavior, nullptr)
 {
 }
 
-osgQOpenGLWindow::osgQOpenGLWindow(osg::ArgumentParser * arguments, QWindow * parent)
-	: QOpenGLWindow(QOpenGLWindow::NoPartialUpdate, nullptr)
+osgQOpenGLWindow::osgQOpenGLWindow(osg::ArgumentParser * arguments, QWindow * parent,
+                                   UpdateBehavior updateBehavior)
+	: QOpenGLWindow(updateBehavior, nullptr)
 	, _arguments(arguments)
 {
 }
@@ -38,9 +39,49 @@ OpenThreads::ReadWriteMutex* osgQOpenGLWindow::mutex()
     return &_osgMutex;
 }
 
+ModelLoadHandle* osgQOpenGLWindow::loadAsync(const QString& path, osg::Group* parent)
+{
+    return renderer()->loadAsync(path, parent);
+}
+
+ModelLoader* osgQOpenGLWindow::modelLoader()
+{
+    return renderer()->modelLoader();
+}
+
+void osgQOpenGLWindow::setPrewarmer(ScenePrewarmer* prewarmer)
+{
+    renderer()->setPrewarmer(prewarmer);
+}
+
+ScenePrewarmer* osgQOpenGLWindow::prewarmer() const
+{
+    return m_renderer ? m_renderer->prewarmer() : nullptr;
+}
+
+OSGRenderer* osgQOpenGLWindow::renderer()
+{
+    if(!m_renderer)
+    {
+        // call this before creating a View...
+        setDefaultDisplaySettings();
+
+        if(!_arguments)
+            m_renderer = new OSGRenderer(this, enQGLWindow);
+        else
+            m_renderer = new OSGRenderer(_arguments, this, enQGLWindow);
+
+        m_renderer->markStartup(OSGRenderer::WidgetConstructed, _constructTick);
+    }
+
+    return m_renderer;
+}
+
 
 void osgQOpenGLWindow::initializeGL()
 {
+    osg::Timer_t initializeTick = osg::Timer::instance()->tick();
+    renderer()->markStartup(OSGRenderer::InitializeGL, initializeTick);
     // Initializes OpenGL function resolution for the current context.
     initializeOpenGLFunctions();
     createRenderer();
@@ -57,11 +98,11 @@ void osgQOpenGLWindow::resizeGL(int w, int h)
 
 void osgQOpenGLWindow::paintGL()
 {
+    OSGQOPENGL_TRACE_ZONE("paintGL");
+    osg::Timer_t lockTick = osg::Timer::instance()->tick();
     OpenThreads::ScopedReadLock locker(_osgMutex);
-	if (_isFirstFrame) {
-		_isFirstFrame = false;
-		m_renderer->getCamera()->getGraphicsContext()->setDefaultFboId(defaultFramebufferObject());
-	}
+    m_renderer->recordReadLockWait(osg::Timer::instance()->delta_s(lockTick, osg::Timer::instance()->tick()));
+    m_renderer->setDefaultFramebuffer(defaultFramebufferObject());
     m_renderer->frame();
 }
 
@@ -130,14 +171,8 @@ void osgQOpenGLWindow::setDefaultDisplaySettings()
 
 void osgQOpenGLWindow::createRenderer()
 {
-    // call this before creating a View...
-    setDefaultDisplaySettings();
-	if (!_arguments) {
-		m_renderer = new OSGRenderer(this, enQGLWindow);
-	}
-	else {
-		m_renderer = new OSGRenderer(_arguments, this, enQGLWindow);
-	}
+    renderer()->setPartialUpdate(updateBehavior() != QOpenGLWindow::NoPartialUpdate);
     double pixelRatio = screen()->devicePixelRatio();
     m_renderer->setupOSG(width(), height(), pixelRatio);
+    connect(this, &QOpenGLWindow::frameSwapped, m_renderer, &OSGRenderer::framePresented);
 }
@@ -0,0 +1,79 @@
+#include <osgQOpenGL/osgQOpenGLWindowWidget>
+#include <osgQOpenGL/osgQOpenGLWindow>
+
+#include <QVBoxLayout>
+
+osgQOpenGLWindowWidget::osgQOpenGLWindowWidget(QWidget* parent)
+    : QWidget(parent),
+      _window(new osgQOpenGLWindow())
+{
+    init();
+}
+
+osgQOpenGLWindowWidget::osgQOpenGLWindowWidget(osg::ArgumentParser* arguments,
+                                               QWidget* parent) :
+    QWidget(parent),
+    _window(new osgQOpenGLWindow(arguments))
+{
+    init();
+}
+
+osgQOpenGLWindowWidget::~osgQOpenGLWindowWidget()
+{
+}
+
+void osgQOpenGLWindowWidget::init()
+{
+    // the container takes the ownership of the window
+    _container = QWidget::createWindowContainer(_window, this);
+    _container->setFocusPolicy(Qt::StrongFocus);
+    _container->setMinimumSize(1, 1);
+    setFocusProxy(_container);
+
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->setSpacing(0);
+    layout->addWidget(_container);
+
+    connect(_window, &osgQOpenGLWindow::initialized, this, &osgQOpenGLWindowWidget::initialized);
+}
+
+osgViewer::Viewer* osgQOpenGLWindowWidget::getOsgViewer()
+{
+    return _window->getOsgViewer();
+}
+
+OpenThreads::ReadWriteMutex* osgQOpenGLWindowWidget::mutex()
+{
+    return _window->mutex();
+}
+
+ModelLoadHandle* osgQOpenGLWindowWidget::loadAsync(const QString& path, osg::Group* parent)
+{
+    return _window->loadAsync(path, parent);
+}
+
+ModelLoader* osgQOpenGLWindowWidget::modelLoader()
+{
+    return _window->modelLoader();
+}
+
+void osgQOpenGLWindowWidget::setPrewarmer(ScenePrewarmer* prewarmer)
+{
+    _window->setPrewarmer(prewarmer);
+}
+
+ScenePrewarmer* osgQOpenGLWindowWidget::prewarmer() const
+{
+    return _window->prewarmer();
+}
+
+void osgQOpenGLWindowWidget::setFormat(const QSurfaceFormat& format)
+{
+    _window->setFormat(format);
+}
+
+QSurfaceFormat osgQOpenGLWindowWidget::format() const
+{
+    return _window->format();
+}
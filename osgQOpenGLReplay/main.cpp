@@ -0,0 +1,82 @@
+// Headless benchmark run of an input recording of OSGRenderer, see ReplayHarness.
+//
+//     osgQOpenGLReplay model.osgb navigation.rec [--timings frames.csv]
+//                      [--real-time] [--size 1920 1080] [-platform offscreen]
+
+#include <osgQOpenGL/ReplayHarness>
+
+#include <osgDB/ReadFile>
+#include <osg/ArgumentParser>
+
+#include <QGuiApplication>
+
+#include <iostream>
+
+int main(int argc, char** argv)
+{
+    // the offscreen context needs the platform plugin, which takes its own options
+    QGuiApplication application(argc, argv);
+    osg::ArgumentParser arguments(&argc, argv);
+    arguments.getApplicationUsage()->setCommandLineUsage(arguments.getApplicationName() +
+                                                         " [options] scene recording");
+    arguments.getApplicationUsage()->addCommandLineOption("--timings <file>",
+                                                          "Write the frame timings as CSV.");
+    arguments.getApplicationUsage()->addCommandLineOption("--real-time",
+                                                          "Replay the events at their recorded time instead of frame by frame.");
+    arguments.getApplicationUsage()->addCommandLineOption("--size <width> <height>",
+                                                          "Size of the offscreen framebuffer.");
+
+    osg::ref_ptr<ReplayHarness> harness = new ReplayHarness();
+
+    std::string timingsFileName;
+
+    while(arguments.read("--timings", timingsFileName)) {}
+
+    while(arguments.read("--real-time"))
+        harness->setTiming(InputRecorder::REAL_TIME);
+
+    int width = harness->getWidth();
+    int height = harness->getHeight();
+
+    while(arguments.read("--size", width, height))
+        harness->setSize(width, height);
+
+    if(arguments.read("-h") || arguments.read("--help") || arguments.argc() != 3)
+    {
+        arguments.getApplicationUsage()->write(std::cout);
+        return 1;
+    }
+
+    osg::ref_ptr<osg::Node> scene = osgDB::readRefNodeFile(arguments[1]);
+
+    if(!scene)
+    {
+        std::cerr << arguments.getApplicationName() << ": can not read " << arguments[1] << std::endl;
+        return 1;
+    }
+
+    if(!harness->run(scene.get(), arguments[2]))
+        return 1;
+
+    const std::vector<InputRecorder::FrameTiming>& timings =
+        harness->getInputRecorder()->getFrameTimings();
+    double total = 0.0;
+
+    for(std::vector<InputRecorder::FrameTiming>::const_iterator itr = timings.begin();
+        itr != timings.end();
+        ++itr)
+    {
+        total += itr->duration;
+    }
+
+    std::cout << timings.size() << " frames, " << (timings.empty() ? 0.0 : total / timings.size()) *
+              1000.0 << " ms average" << std::endl;
+
+    if(!timingsFileName.empty() && !harness->getInputRecorder()->writeFrameTimings(timingsFileName))
+    {
+        std::cerr << arguments.getApplicationName() << ": can not write " << timingsFileName << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
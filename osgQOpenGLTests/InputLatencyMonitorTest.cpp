@@ -0,0 +1,246 @@
+// Headless checks of InputLatencyMonitor, alone and driven by the frames of an
+// offscreen OSGRenderer, returns the number of failed checks.
+//
+//     osgQOpenGLTests [-platform offscreen]
+
+#include <osgQOpenGL/InputLatencyMonitor>
+#include <osgQOpenGL/OSGRenderer>
+
+#include <osg/Geode>
+#include <osg/Shape>
+#include <osg/ShapeDrawable>
+#include <osg/Timer>
+
+#include <QGuiApplication>
+#include <QMouseEvent>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+
+#include <cmath>
+#include <iostream>
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool condition, const char* what, int line)
+    {
+        if(!condition)
+        {
+            std::cerr << "InputLatencyMonitorTest.cpp(" << line << "): failed " << what << std::endl;
+            ++failures;
+        }
+    }
+
+    #define CHECK(condition) check((condition), #condition, __LINE__)
+
+    bool equal(double a, double b)
+    {
+        return std::fabs(a - b) < 1e-6;
+    }
+
+    osg::Timer_t tick(double seconds)
+    {
+        return static_cast<osg::Timer_t>(seconds / osg::Timer::instance()->getSecondsPerTick());
+    }
+
+    // one frame consuming one input, presented latency seconds after it
+    void addLatency(InputLatencyMonitor& monitor, double latency)
+    {
+        const double inputTime = 100.0;
+        monitor.addInput(tick(inputTime));
+        monitor.beginFrame();
+        monitor.present(tick(inputTime + latency));
+    }
+
+    void testPercentiles()
+    {
+        osg::ref_ptr<InputLatencyMonitor> monitor = new InputLatencyMonitor();
+        CHECK(equal(monitor->getPercentile(50.0), 0.0));
+
+        for(int latency = 1; latency <= 10; ++latency)
+            addLatency(*monitor, latency);
+
+        CHECK(monitor->getNumSamples() == 10);
+
+        // the smallest sample with at least percentile percent of the samples at or below it
+        CHECK(equal(monitor->getPercentile(0.0), 1.0));
+        CHECK(equal(monitor->getPercentile(10.0), 1.0));
+        CHECK(equal(monitor->getPercentile(11.0), 2.0));
+        CHECK(equal(monitor->getPercentile(50.0), 5.0));
+        CHECK(equal(monitor->getPercentile(90.0), 9.0));
+        CHECK(equal(monitor->getPercentile(95.0), 10.0));
+        CHECK(equal(monitor->getPercentile(100.0), 10.0));
+        CHECK(equal(monitor->getPercentile(150.0), 10.0));
+    }
+
+    void testCarryOver()
+    {
+        osg::ref_ptr<InputLatencyMonitor> monitor = new InputLatencyMonitor();
+
+        // the first frame is never presented, its input is reported with the second one
+        monitor->addInput(tick(10.0));
+        monitor->beginFrame();
+        monitor->addInput(tick(11.0));
+        monitor->beginFrame();
+
+        // added after the last frame began, left for the next frame
+        monitor->addInput(tick(12.5));
+        monitor->present(tick(13.0));
+
+        CHECK(monitor->getNumSamples() == 2);
+        CHECK(equal(monitor->getLastLatency(), 3.0));
+        CHECK(equal(monitor->getPercentile(0.0), 2.0));
+        CHECK(equal(monitor->getPercentile(100.0), 3.0));
+
+        // a frame without inputs
+        monitor->present(tick(14.0));
+        CHECK(monitor->getNumSamples() == 2);
+        CHECK(equal(monitor->getLastLatency(), 0.0));
+
+        monitor->beginFrame();
+        monitor->present(tick(15.0));
+        CHECK(monitor->getNumSamples() == 3);
+        CHECK(equal(monitor->getLastLatency(), 2.5));
+    }
+
+    void testRingOrder()
+    {
+        osg::ref_ptr<InputLatencyMonitor> monitor = new InputLatencyMonitor();
+        monitor->setMaxSamples(4);
+
+        // 5 and 6 overwrite 1 and 2
+        for(int latency = 1; latency <= 6; ++latency)
+            addLatency(*monitor, latency);
+
+        CHECK(monitor->getNumSamples() == 4);
+        CHECK(equal(monitor->getPercentile(0.0), 3.0));
+        CHECK(equal(monitor->getPercentile(100.0), 6.0));
+
+        // the latest samples are kept, not the first slots of the ring
+        monitor->setMaxSamples(2);
+        CHECK(monitor->getNumSamples() == 2);
+        CHECK(equal(monitor->getPercentile(0.0), 5.0));
+        CHECK(equal(monitor->getPercentile(100.0), 6.0));
+
+        // and the oldest of them is overwritten next
+        addLatency(*monitor, 7.0);
+        CHECK(monitor->getNumSamples() == 2);
+        CHECK(equal(monitor->getPercentile(0.0), 6.0));
+        CHECK(equal(monitor->getPercentile(100.0), 7.0));
+
+        // growing keeps the samples
+        monitor->setMaxSamples(8);
+        addLatency(*monitor, 1.0);
+        CHECK(monitor->getNumSamples() == 3);
+        CHECK(equal(monitor->getPercentile(0.0), 1.0));
+        CHECK(equal(monitor->getPercentile(100.0), 7.0));
+    }
+
+    void moveMouse(OSGRenderer& renderer, int x)
+    {
+        QMouseEvent event(QEvent::MouseMove, QPointF(x, 10.0), Qt::NoButton, Qt::NoButton,
+                          Qt::NoModifier);
+        renderer.mouseMoveEvent(&event);
+    }
+
+    // a frame as the widgets' timer runs it for the scheme, false if none was needed
+    bool runFrame(OSGRenderer& renderer, GLuint framebuffer)
+    {
+        if(renderer.getRunFrameScheme() == osgViewer::ViewerBase::ON_DEMAND
+           && !renderer.checkNeedToDoFrame())
+        {
+            return false;
+        }
+
+        renderer.setDefaultFramebuffer(framebuffer);
+        renderer.frame();
+        return true;
+    }
+
+    // the inputs go through the renderer's event handling and frames, the widgets'
+    // frameSwapped() is stood in for by framePresented(). The renderer only runs
+    // single threaded, the run frame schemes are the ones to cover
+    void testRenderer(osgViewer::ViewerBase::FrameScheme scheme)
+    {
+        const int width = 64;
+        const int height = 64;
+
+        QOpenGLContext context;
+        QOffscreenSurface surface;
+        surface.create();
+
+        if(!context.create() || !context.makeCurrent(&surface))
+        {
+            std::cerr << "InputLatencyMonitorTest: no OpenGL context, renderer checks skipped"
+                      << std::endl;
+            return;
+        }
+
+        QOpenGLFramebufferObjectFormat format;
+        format.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+        QOpenGLFramebufferObject target(width, height, format);
+
+        osg::ref_ptr<osg::Geode> scene = new osg::Geode();
+        scene->addDrawable(new osg::ShapeDrawable(new osg::Box(osg::Vec3(), 1.0f)));
+
+        // released before the target and the context
+        osg::ref_ptr<OSGRenderer> renderer = new OSGRenderer(nullptr, enOffscreen);
+        renderer->setupOSG(width, height, 1.0f);
+        renderer->resize(width, height, 1.0f);
+        renderer->setRunFrameScheme(scheme);
+        renderer->setSceneData(scene.get());
+        renderer->setInputLatencyMonitoring(true);
+
+        // the frames of the setup carry no input
+        while(runFrame(*renderer, target.handle())
+              && renderer->getFrameStamp()->getFrameNumber() < 2) {}
+
+        renderer->framePresented();
+        InputLatencyMonitor* monitor = renderer->inputLatencyMonitor();
+        CHECK(monitor->getNumSamples() == 0);
+
+        // an input is reported with the frame that consumed it once presented
+        moveMouse(*renderer, 10);
+        CHECK(runFrame(*renderer, target.handle()));
+        CHECK(monitor->getNumSamples() == 0);
+        renderer->framePresented();
+        CHECK(monitor->getNumSamples() == 1);
+        CHECK(monitor->getLastLatency() > 0.0);
+
+        // a frame that is not presented passes its input on to the next presented one,
+        // the input after it is consumed by that one
+        moveMouse(*renderer, 20);
+        CHECK(runFrame(*renderer, target.handle()));
+        moveMouse(*renderer, 30);
+        CHECK(runFrame(*renderer, target.handle()));
+        renderer->framePresented();
+        CHECK(monitor->getNumSamples() == 3);
+        CHECK(monitor->getPercentile(100.0) >= monitor->getLastLatency());
+
+        // presented again without a new frame
+        renderer->framePresented();
+        CHECK(monitor->getNumSamples() == 3);
+        CHECK(equal(monitor->getLastLatency(), 0.0));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    // the offscreen context needs the platform plugin
+    QGuiApplication application(argc, argv);
+
+    testPercentiles();
+    testCarryOver();
+    testRingOrder();
+    testRenderer(osgViewer::ViewerBase::CONTINUOUS);
+    testRenderer(osgViewer::ViewerBase::ON_DEMAND);
+
+    if(failures)
+        std::cerr << failures << " checks failed" << std::endl;
+    else
+        std::cout << "all checks passed" << std::endl;
+
+    return failures;
+}